@@ -0,0 +1,451 @@
+#ifndef ADAPTIVE_SNZI_HPP_
+#define ADAPTIVE_SNZI_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <atomic>
+#include "config.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class adaptive_snzi implements a SNZI object whose shape follows the actual load.
+	 *
+	 * The snzi classes in snzi.hpp assign threads to leaves uniformly (threads_per_leaf threads per leaf). When a few hot threads
+	 * dominate some leaves while others sit idle, the hot leaves suffer from CAS retries while the cold ones are wasted. An adaptive_snzi
+	 * allocates a tree of (maximum) height H, either perfect K-ary or with per-level fan-outs (see tree_shape), but a thread does not necessarily use a node at the last level. Instead,
+	 * each node carries a split flag and a thread uses the first node on the path from the root to its last-level node that is not split.
+	 * Initially all the nodes at depth initial_depth are not split (and all the nodes above them are), so the tree starts shallow. The root
+	 * has no split flag and never takes the arrivals of threads directly, so initial_depth is at least 1, unless the tree is only the root.
+	 *
+	 * Each node measures how many of its CAS operations fail. Time is measured in windows of adaptation_policy::window Arrive operations
+	 * on that node. The thread that closes a window inspects the number of CAS failures during it:
+	 * 			+ If the failures are at least adaptation_policy::split_threshold then the node is split; its users move to its children.
+	 * 			+ If the failures are at most adaptation_policy::merge_threshold then the node is marked cold. If all of its siblings are
+	 * 			  also cold (and not split) then their parent is merged back; its users move back to it.
+	 * A node is not cold until it closes a cold window, and the children of a node that is split stop being cold, so a parent is merged only
+	 * after each of its children has closed a cold window since the split.
+	 * The gap between the two thresholds provides the hysteresis that keeps a node from bouncing between the two states.
+	 *
+	 * Splitting and merging never affects correctness. A SNZI node does not distinguish Arrive operations coming from its children from
+	 * Arrive operations coming directly from threads, so any node can be used as a leaf. The only requirement is that a thread departs from the
+	 * same node it arrived at; for this reason a thread remembers the node it used in its own slot, and only moves to a new node when it has no
+	 * outstanding Arrive operations. Threads find out that the shape of the tree has changed through an epoch counter, so in the common case
+	 * routing costs a single load from a line that is rarely written.
+	 *
+	 * The per-node statistics (see statistics()) show how many arrivals and CAS failures each node saw and when and why it was split or merged.
+	 *
+	 * The thread identifiers must be in the range [0,T). The leaf assignment for the last level is the same as in snzi.hpp.
+	 */
+	class adaptive_snzi{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+		using stat_type = unsigned long; //! For statistics counters
+
+		/**
+		 * Parameters that drive the splitting and merging of nodes.
+		 */
+		struct adaptation_policy{
+			stat_type window{1024}; //! Number of Arrive operations on a node that form one measurement window
+			stat_type split_threshold{256}; //! A node whose CAS failures in a window are at least this is split
+			stat_type merge_threshold{16}; //! A node whose CAS failures in a window are at most this is cold
+			size_type initial_depth{1}; //! The depth of the nodes that threads use initially
+		};
+
+		/**
+		 * A snapshot of the statistics of a single node.
+		 */
+		struct node_statistics{
+			size_type id; //! The index of the node
+			size_type parent; //! The index of its parent
+			size_type depth; //! The depth of the node (the root has depth 0)
+			bool split; //! Whether the node is currently split
+			bool cold; //! Whether the last window of the node was cold
+			stat_type arrivals; //! Arrive operations applied to this node (both direct and propagated)
+			stat_type cas_failures; //! CAS failures in closed windows
+			stat_type splits; //! How many times this node was split
+			stat_type merges; //! How many times this node was merged back
+			stat_type last_split_arrivals; //! The value of arrivals when the node was last split
+			stat_type last_split_failures; //! The CAS failures of the window that caused the last split
+			stat_type last_merge_arrivals; //! The value of arrivals when the node was last merged
+		};
+
+	private:
+		using counter_type = std::uint64_t; //! Type used for the counter at each SNZI node
+
+		struct root_node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+
+			root_node(){
+				X.store(0, snzi_order::init);
+			}
+
+			void Arrive(){
+				X.fetch_add(1, snzi_order::root_arrive);
+			}
+
+			void Depart(){
+				X.fetch_sub(1, snzi_order::root_depart);
+			}
+
+			bool Query() const{
+				return X.load(snzi_order::query) != 0;
+			}
+		};
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			std::atomic<bool> split;
+			std::atomic<bool> cold;
+			std::atomic<stat_type> window_arrivals; //! Never reset; windows close at its multiples
+			std::atomic<stat_type> window_failures; //! CAS failures in the current window
+			// The following are written only when a window closes
+			std::atomic<stat_type> cas_failures;
+			std::atomic<stat_type> splits;
+			std::atomic<stat_type> merges;
+			std::atomic<stat_type> last_split_arrivals;
+			std::atomic<stat_type> last_split_failures;
+			std::atomic<stat_type> last_merge_arrivals;
+			size_type parent;
+			size_type depth;
+			adaptive_snzi* snzi_tree;
+
+			node(){
+				X.store(0, snzi_order::init);
+				split.store(false);
+				cold.store(false);
+				window_arrivals.store(0);
+				window_failures.store(0);
+				cas_failures.store(0);
+				splits.store(0);
+				merges.store(0);
+				last_split_arrivals.store(0);
+				last_split_failures.store(0);
+				last_merge_arrivals.store(0);
+			}
+
+			void Arrive(){
+				bool pArrInv = false;
+				stat_type failures = 0;
+
+				counter_type oldx = X.load(snzi_order::probe);
+
+				for (;;){
+					if (!oldx && !pArrInv){
+						snzi_tree->arrive_at(parent);
+						pArrInv = true;
+					}
+					if (X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure)){
+						break;
+					}
+					++failures;
+				}
+
+				if (pArrInv && oldx){
+					snzi_tree->depart_at(parent);
+				}
+
+				if (failures){
+					window_failures.fetch_add(failures, std::memory_order_relaxed);
+				}
+				stat_type n = window_arrivals.fetch_add(1, std::memory_order_relaxed) + 1;
+				if (n % snzi_tree->policy.window == 0){
+					snzi_tree->close_window(*this, n);
+				}
+			}
+
+			void Depart(){
+				counter_type oldx = X.load(snzi_order::probe);
+
+				while (!X.compare_exchange_weak(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure)){}
+
+				if (oldx == 1){
+					snzi_tree->depart_at(parent);
+				}
+			}
+		};
+
+		/**
+		 * The routing state of a single thread. It is only accessed by its owner, except for the statistics.
+		 */
+		struct thread_slot{
+			alignas(CACHE_LINE_SIZE) size_type node{0}; //! The node where the thread arrives
+			size_type outstanding{0}; //! Arrive operations not yet matched by a Depart
+			stat_type epoch{0}; //! The shape epoch at which node was computed (the shape epoch starts at 1)
+		};
+
+	public:
+
+		friend class root_node;
+		friend class node;
+
+		/**
+		 * Constructs an adaptive SNZI over a perfect K-ary tree with maximum height H. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * The following restrictions are applied to the parameters:
+		 * 			+ K must be larger than or equal to 2.
+		 * 			+ policy.window must be larger than 0.
+		 * 			+ policy.merge_threshold must be lower than policy.split_threshold.
+		 * 			+ policy.initial_depth must be larger than or equal to 1 and lower than or equal to H (or 0 if H is 0).
+		 * If at least one of the above restrictions is not satisfied then an invalid_argument exception is thrown with a suitable error message string.
+		 *
+		 * Note that this constructor doesn't guarnatee memory visibility of the construction. This should be established by other means.
+		 *
+		 * \param K The arity of the SNZI tree
+		 * \param H The maximum height of the SNZI tree
+		 * \param T The number of threads to use this SNZI object
+		 * \param policy The parameters for splitting and merging nodes
+		 * \throws std::invalid_argument If at least one of the restrictions is not satisfied.
+		 */
+		adaptive_snzi(size_type K, size_type H, size_type T, adaptation_policy policy) : adaptive_snzi(tree_shape::uniform(K,H), T, policy){}
+
+		/**
+		 * Constructs an adaptive SNZI whose levels have the given fan-outs, listed from the root downwards (see tree_shape).
+		 *
+		 * \throws std::invalid_argument If any fan-out is lower than 2 or the policy is invalid (see above).
+		 */
+		adaptive_snzi(const std::vector<size_type>& fanout, size_type T, adaptation_policy policy) : adaptive_snzi(tree_shape(fanout), T, policy){}
+
+		/**
+		 * Constructs an adaptive SNZI with the given shape.
+		 *
+		 * \throws std::invalid_argument If the policy is invalid (see above).
+		 */
+		adaptive_snzi(const tree_shape& shape, size_type T, adaptation_policy policy) : policy(policy), shape(shape){
+			if (!policy.window){
+				throw std::invalid_argument("window in adaptive_snzi policy must be > 0");
+			}
+			if (policy.merge_threshold >= policy.split_threshold){
+				throw std::invalid_argument("merge_threshold in adaptive_snzi policy must be < split_threshold");
+			}
+			if (policy.initial_depth > shape.height()){
+				throw std::invalid_argument("initial_depth in adaptive_snzi policy must be <= H");
+			}
+			if (!policy.initial_depth && shape.height()){
+				throw std::invalid_argument("initial_depth in adaptive_snzi policy must be >= 1 (the root cannot be split)");
+			}
+
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
+			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			total_threads = T;
+			shape_epoch.store(1);
+
+			// See no_contention_handling_snzi for why we allocate total_nodes nodes
+			others.reset(new node[total_nodes]);
+			slots.reset(new thread_slot[T ? T : 1]);
+
+			for (size_type i = 1; i < total_nodes; ++i){
+				others[i].snzi_tree = this;
+				others[i].parent = shape.parent(i);
+				others[i].depth = shape.depth(i);
+				others[i].split.store(others[i].depth < policy.initial_depth);
+			}
+		}
+
+		/**
+		 * Constructs an adaptive SNZI with the default adaptation_policy.
+		 */
+		adaptive_snzi(size_type K, size_type H, size_type T) : adaptive_snzi(K, H, T, adaptation_policy{}){}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation by the same thread.
+		 */
+		void Arrive(size_type tid){
+			thread_slot& slot = slots[tid];
+
+			if (!slot.outstanding){
+				stat_type epoch = shape_epoch.load();
+				if (slot.epoch != epoch){
+					slot.node = route(tid);
+					slot.epoch = epoch;
+				}
+			}
+			++slot.outstanding;
+
+			arrive_at(slot.node);
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), after it has called Arrive() to declare
+		 * that is "departs".
+		 */
+		void Depart(size_type tid){
+			thread_slot& slot = slots[tid];
+
+			assert(slot.outstanding);
+			--slot.outstanding;
+
+			depart_at(slot.node);
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in the SNZI tree.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool Query() const{
+			return root.Query();
+		}
+
+		/**
+		 * Returns a snapshot of the statistics of every node except the root. The snapshot is not atomic; it is meant for monitoring and tuning.
+		 */
+		std::vector<node_statistics> statistics() const{
+			std::vector<node_statistics> stats;
+			stats.reserve(total_nodes ? total_nodes - 1 : 0);
+
+			for (size_type i = 1; i < total_nodes; ++i){
+				const node& n = others[i];
+				node_statistics s;
+				s.id = i;
+				s.parent = n.parent;
+				s.depth = n.depth;
+				s.split = n.split.load();
+				s.cold = n.cold.load();
+				s.arrivals = n.window_arrivals.load();
+				s.cas_failures = n.cas_failures.load();
+				s.splits = n.splits.load();
+				s.merges = n.merges.load();
+				s.last_split_arrivals = n.last_split_arrivals.load();
+				s.last_split_failures = n.last_split_failures.load();
+				s.last_merge_arrivals = n.last_merge_arrivals.load();
+				stats.push_back(s);
+			}
+
+			return stats;
+		}
+
+		/**
+		 * Returns the index of the node that the thread with identifier tid would use if it arrived now.
+		 */
+		size_type current_node_for_thread(size_type tid) const{
+			return route(tid);
+		}
+
+	private:
+		adaptation_policy policy; //! When to split and merge nodes
+		tree_shape shape; //! The shape of the SNZI tree (with all nodes split)
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of nodes in the last level of the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each node in the last level
+		size_type total_threads; //! Number of threads to use this SNZI object
+		root_node root; //! The root SNZI object of the tree
+		alignas(CACHE_LINE_SIZE) std::atomic<stat_type> shape_epoch; //! Incremented whenever a node is split or merged
+		std::unique_ptr<node[]> others{nullptr}; //! The other SNZI objects of the tree
+		std::unique_ptr<thread_slot[]> slots{nullptr}; //! The routing state of each thread
+
+		void arrive_at(size_type id){
+			switch(id){
+			case 0:
+				root.Arrive();
+				break;
+			default:
+				others[id].Arrive();
+				break;
+			}
+		}
+
+		void depart_at(size_type id){
+			switch(id){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				others[id].Depart();
+				break;
+			}
+		}
+
+		/**
+		 * Returns the first node on the path from the root to the last-level node of thread tid that is not split. If all of them are
+		 * split then the last-level node is returned since it cannot be split any further.
+		 */
+		size_type route(size_type tid) const{
+			size_type id = total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+			size_type result = id;
+
+			// walk upwards remembering the shallowest node that is not split
+			while (id){
+				if (!others[id].split.load()){
+					result = id;
+				}
+				id = others[id].parent;
+			}
+
+			return result;
+		}
+
+		/**
+		 * Called by the thread whose Arrive operation completed the n-th arrival at node n (which is a multiple of the window).
+		 */
+		void close_window(node& n, stat_type arrivals){
+			stat_type failures = n.window_failures.exchange(0);
+			n.cas_failures.fetch_add(failures);
+
+			if (failures >= policy.split_threshold){
+				n.cold.store(false);
+				bool expected = false;
+				// nodes in the last level have no children to move to
+				if (n.depth < shape.height() && n.split.compare_exchange_strong(expected, true)){
+					// the windows of the children before the split do not count towards merging it back
+					size_type first = shape.first_child(static_cast<size_type>(&n - &others[0]));
+					for (size_type c = first; c < first + shape.fanout(n.depth); ++c){
+						others[c].cold.store(false);
+					}
+					n.splits.fetch_add(1);
+					n.last_split_arrivals.store(arrivals);
+					n.last_split_failures.store(failures);
+					shape_epoch.fetch_add(1);
+				}
+			}
+			else if (failures <= policy.merge_threshold){
+				n.cold.store(true);
+				try_merge(n.parent, arrivals);
+			}
+			else{
+				n.cold.store(false);
+			}
+		}
+
+		/**
+		 * Merges the node with index p if all of its children are cold and not split. The root is never merged.
+		 */
+		void try_merge(size_type p, stat_type arrivals){
+			if (!p || p < shape.level_offset(policy.initial_depth)){
+				return ;
+			}
+
+			size_type first = shape.first_child(p);
+			for (size_type c = first; c < first + shape.fanout(others[p].depth); ++c){
+				if (others[c].split.load() || !others[c].cold.load()){
+					return ;
+				}
+			}
+
+			bool expected = true;
+			if (others[p].split.compare_exchange_strong(expected, false)){
+				others[p].merges.fetch_add(1);
+				others[p].last_merge_arrivals.store(arrivals);
+				shape_epoch.fetch_add(1);
+			}
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* ADAPTIVE_SNZI_HPP_ */
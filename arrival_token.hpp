@@ -0,0 +1,32 @@
+#ifndef ARRIVAL_TOKEN_HPP_
+#define ARRIVAL_TOKEN_HPP_
+
+#include <cstddef>
+
+namespace concurrent{
+
+	/**
+	 * Returned by an Arrive operation: identifies the node of the SNZI tree at which the operation arrived (0 for the root), so that
+	 * Depart(token) departs from the same node without recomputing it from the identifier of the thread. The matching Depart operation can
+	 * therefore be made by any thread, for example by the worker that completes an asynchronous task that another worker started.
+	 */
+	class arrival_token{
+	public:
+		using size_type = std::size_t; //! For node indices
+
+		explicit arrival_token(size_type node) : id(node){}
+
+		/**
+		 * \return The index of the node at which the Arrive operation arrived, in level order (see tree_shape).
+		 */
+		size_type node() const{
+			return id;
+		}
+
+	private:
+		size_type id; //! The index of the node
+	};
+
+} // namespace concurrent
+
+#endif /* ARRIVAL_TOKEN_HPP_ */
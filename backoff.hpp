@@ -2,34 +2,197 @@
 #define BACKOFF_HPP_
 
 #include <cstddef>
+#include <cstdint>
+#include <chrono>
 #include <thread>
+#include <atomic>
 
 namespace concurrent{
-	
-	class exponential_backoff{
+
+	/**
+	 * Backoff policies.
+	 *
+	 * A backoff policy is a class with a backoff() member function, called after each failed attempt, and a reset() member function
+	 * that forgets the previous failures. The SNZI classes that back off (semi_contention_handling_snzi and full_contention_handling_snzi)
+	 * take the policy as a template argument, so it can be chosen per SNZI object.
+	 *
+	 * The delays of the spinning policies are counted in pause instructions, whose latency ranges from about 10 cycles to about 140 cycles
+	 * depending on the microarchitecture (it grew considerably with Skylake). Constants tuned on one part are therefore wrong on another;
+	 * calibrated_backoff counts nanoseconds instead.
+	 */
+
+	namespace backoff_detail{
+
+		inline void pause(std::size_t delay){
+			for (std::size_t i = 0; i < delay; ++i){
+				__asm__ __volatile__("pause;");
+			}
+		}
+
+		inline std::uint64_t rdtsc(){
+			std::uint32_t lo, hi;
+			__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+			return (static_cast<std::uint64_t>(hi) << 32) | lo;
+		}
+
+		/**
+		 * Returns the number of time stamp counter ticks per nanosecond. It is measured once, the first time it is called, by comparing the
+		 * time stamp counter against std::chrono::steady_clock over about a millisecond.
+		 */
+		inline double tsc_ticks_per_ns(){
+			static const double ticks_per_ns = []{
+				auto start = std::chrono::steady_clock::now();
+				std::uint64_t start_ticks = rdtsc();
+				while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1)){}
+				std::uint64_t ticks = rdtsc() - start_ticks;
+				auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				return ns > 0 ? static_cast<double>(ticks)/static_cast<double>(ns) : 1.0;
+			}();
+			return ticks_per_ns;
+		}
+
+	} // namespace backoff_detail
+
+	/**
+	 * Adapts a backoff policy to waits on a word: wait(b, word, observed) is called by a thread that waits for word to change from observed,
+	 * and notify(word) by a thread that made such a change. By default the wait is a plain backoff() and notify() does nothing, so the
+	 * policies in this file cost nothing extra; policies that can block (see parking_backoff in parking.hpp) specialize it.
+	 */
+	template<typename Backoff>
+	struct backoff_traits{
+		template<typename T>
+		static void wait(Backoff& b, const std::atomic<T>&, T){
+			b.backoff();
+		}
+
+		template<typename T>
+		static void notify(const std::atomic<T>&){}
+	};
+
+	/**
+	 * Spins 1,2,4,...,MaxTries pause instructions in successive calls and then yields the processor in every call.
+	 */
+	template<std::size_t MaxTries = 16>
+	class basic_exponential_backoff{
 	public:
 		void backoff(){
 			if (tries <= MAX_TRIES){
 				backoff(tries);
 				tries *= 2;
 			}
-			else{	
+			else{
 				std::this_thread::yield();
 			}
 		}
 
 		void reset(){ tries = 1; }
 	private:
-		static const std::size_t MAX_TRIES = 16;
-		std::size_t tries{1}; 
+		static const std::size_t MAX_TRIES = MaxTries;
+		std::size_t tries{1};
 
 		void backoff(std::size_t delay) const{
-			for (std::size_t i = 0; i < delay; ++i){
-				__asm__ __volatile__("pause;");
-			}			
+			backoff_detail::pause(delay);
 		}
 	};
 
+	/**
+	 * The policy tuned on the Intel Core i7 2600K.
+	 */
+	using exponential_backoff = basic_exponential_backoff<>;
+
+	/**
+	 * Does not back off at all; failed attempts are retried immediately.
+	 */
+	class no_backoff{
+	public:
+		void backoff(){}
+
+		void reset(){}
+	};
+
+	/**
+	 * Bounded exponential backoff with jitter: the limit starts at MinDelay pause instructions and doubles in each call up to MaxDelay, and
+	 * each call spins a random number of pause instructions in [limit/2, limit]. The jitter keeps threads that failed together from retrying
+	 * together. It never yields.
+	 */
+	template<std::size_t MinDelay = 4, std::size_t MaxDelay = 1024>
+	class jittered_exponential_backoff{
+		static_assert(MinDelay >= 1 && MinDelay <= MaxDelay, "invalid delays for jittered_exponential_backoff");
+
+	public:
+		jittered_exponential_backoff() : seed(static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(this) >> 4) | 1u){}
+
+		void backoff(){
+			std::size_t half = limit/2;
+			backoff_detail::pause(half + next_random() % (limit - half + 1));
+			if (limit < MaxDelay){
+				limit = limit*2 < MaxDelay ? limit*2 : MaxDelay;
+			}
+		}
+
+		void reset(){ limit = MinDelay; }
+	private:
+		std::size_t limit{MinDelay};
+		std::uint32_t seed;
+
+		// xorshift32
+		std::uint32_t next_random(){
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return seed;
+		}
+	};
+
+	/**
+	 * Backs off proportionally to the contention observed so far: the n-th consecutive call spins n*Step pause instructions, up to MaxDelay.
+	 * The delay grows linearly, so it adapts more slowly but overshoots less than the exponential policies.
+	 */
+	template<std::size_t Step = 8, std::size_t MaxDelay = 1024>
+	class proportional_backoff{
+		static_assert(Step >= 1 && Step <= MaxDelay, "invalid delays for proportional_backoff");
+
+	public:
+		void backoff(){
+			delay = delay + Step < MaxDelay ? delay + Step : MaxDelay;
+			backoff_detail::pause(delay);
+		}
+
+		void reset(){ delay = 0; }
+	private:
+		std::size_t delay{0};
+	};
+
+	/**
+	 * Exponential backoff whose delays are measured in nanoseconds with the time stamp counter: MinNanos, 2*MinNanos, ... up to MaxNanos,
+	 * after which the processor is yielded in every call. The time stamp counter is calibrated once per process (see
+	 * backoff_detail::tsc_ticks_per_ns()), so the delays mean the same on every microarchitecture regardless of the latency of pause.
+	 * It requires an invariant time stamp counter.
+	 */
+	template<std::size_t MinNanos = 32, std::size_t MaxNanos = 4096>
+	class calibrated_backoff{
+		static_assert(MinNanos >= 1 && MinNanos <= MaxNanos, "invalid delays for calibrated_backoff");
+
+	public:
+		void backoff(){
+			if (nanos <= MaxNanos){
+				const std::uint64_t ticks = static_cast<std::uint64_t>(nanos*backoff_detail::tsc_ticks_per_ns());
+				const std::uint64_t start = backoff_detail::rdtsc();
+				while (backoff_detail::rdtsc() - start < ticks){
+					backoff_detail::pause(1);
+				}
+				nanos *= 2;
+			}
+			else{
+				std::this_thread::yield();
+			}
+		}
+
+		void reset(){ nanos = MinNanos; }
+	private:
+		std::size_t nanos{MinNanos};
+	};
+
 } // namespace concurrent
 
 #endif
@@ -0,0 +1,173 @@
+#ifndef BIASED_SNZI_HPP_
+#define BIASED_SNZI_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <atomic>
+#include "config.hpp"
+#include "backoff.hpp"
+#include "snzi_handle.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class biased_snzi adds biased (sticky) arrivals to a SNZI object of type Snzi, for threads that Arrive and Depart in tight loops.
+	 *
+	 * A Depart operation does not depart from the SNZI object: it leaves the arrival of the thread parked in a per-thread slot, and the next
+	 * Arrive operation of the thread takes it back with a CAS on that slot, which stays in the cache of the thread as long as nobody else
+	 * looks at it. The tree is touched again only after a revocation. This is the indicator equivalent of biased locking: it pays off when
+	 * each thread arrives and departs repeatedly and queriers are rare.
+	 *
+	 * A parked arrival is still counted by the SNZI object, so Query() may report a surplus that is only made of parked arrivals. A querier
+	 * that needs an accurate answer calls QueryAccurate(), which first revokes the parked arrivals: for each slot it takes the parked arrival
+	 * with a CAS and departs from the SNZI object on behalf of its thread. The owner and the revoker race on the same slot, so exactly one of
+	 * them gets a parked arrival. An owner that loses waits until the revoker has departed and then arrives at the tree again. An arrival that
+	 * is parked after the scan is counted again; such an arrival was active during the call, so a caller that stops new arrivals first (as a
+	 * writer does) and retries while the answer is true gets an exact answer.
+	 *
+	 * The Arrive operations of a thread may nest: the slot counts the nesting, only the outermost Arrive operation takes the parked arrival
+	 * back or arrives at the SNZI object, and only the Depart operation that matches it parks the arrival. A thread therefore has at most
+	 * one arrival in the SNZI object, and a revocation departs exactly once on its behalf.
+	 *
+	 * Snzi must be constructible from (K,H,T) and its operations are called through snzi_thread_traits (see snzi_handle.hpp); the per-thread
+	 * state of full_contention_handling_snzi is kept in the slot, so the revoker can depart on behalf of the owner. A snzi_handle can be bound
+	 * to a biased_snzi as to any other SNZI object.
+	 */
+	template<typename Snzi>
+	class biased_snzi{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+		using snzi_type = Snzi; //! The type of the underlying SNZI object
+
+		/**
+		 * Constructs the underlying SNZI object with the parameters K, H and T, and one slot for each of the T threads.
+		 *
+		 * \throws invalid_argument If the underlying SNZI object rejects the parameters.
+		 */
+		biased_snzi(size_type K, size_type H, size_type T) : snzi_object(K, H, T), slots(new slot[T]), total_threads(T){}
+
+		biased_snzi(const biased_snzi&) = delete;
+		biased_snzi& operator=(const biased_snzi&) = delete;
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence. If the thread has a parked
+		 * arrival it takes it back without touching the SNZI object. A nested call only counts the nesting.
+		 */
+		void Arrive(size_type tid){
+			slot& s = slots[tid];
+
+			if (s.nesting++){
+				return ;
+			}
+
+			int status = parked;
+			if (s.status.compare_exchange_strong(status, active, std::memory_order_acquire, std::memory_order_acquire)){
+				return ;
+			}
+
+			// a revoker has taken our parked arrival and departs on our behalf
+			while (status == revoking){
+				backoff_detail::pause(1);
+				status = s.status.load(std::memory_order_acquire);
+			}
+
+			snzi_thread_traits<Snzi>::arrive(snzi_object, tid, s.state);
+			s.status.store(active, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), after it has called Arrive(). The call that matches
+		 * the outermost Arrive() parks the arrival, which stays counted by the SNZI object until the thread arrives again or the arrival is
+		 * revoked.
+		 */
+		void Depart(size_type tid){
+			slot& s = slots[tid];
+
+			if (--s.nesting){
+				return ;
+			}
+			s.status.store(parked, std::memory_order_release);
+		}
+
+		/**
+		 * Departs from the SNZI object if the thread with identifier tid has a parked arrival, for a thread that will not arrive again
+		 * for a long time.
+		 */
+		void Unpark(size_type tid){
+			revoke(tid);
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in the SNZI tree. Parked arrivals are counted as active.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations or a parked arrival.
+		 */
+		bool Query() const{
+			return snzi_object.Query();
+		}
+
+		/**
+		 * Revokes the parked arrivals and then queries the SNZI object.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool QueryAccurate(){
+			Revoke();
+			return snzi_object.Query();
+		}
+
+		/**
+		 * Departs from the SNZI object on behalf of every thread that has a parked arrival.
+		 *
+		 * \return The number of parked arrivals revoked.
+		 */
+		size_type Revoke(){
+			size_type revoked = 0;
+			for (size_type tid = 0; tid < total_threads; ++tid){
+				if (revoke(tid)){
+					++revoked;
+				}
+			}
+			return revoked;
+		}
+
+	private:
+		enum : int { idle, active, parked, revoking }; //! The states of a slot
+
+		struct slot{
+			// to avoid false sharing between the threads
+			alignas(CACHE_LINE_SIZE) std::atomic<int> status;
+			typename snzi_thread_traits<Snzi>::thread_state state; //! Used by the owner, or by the revoker while the status is revoking
+			size_type nesting{0}; //! The nesting depth of the Arrive operations of the owner; only the owner uses it
+
+			slot(){
+				status.store(idle, std::memory_order_relaxed);
+			}
+		};
+
+		Snzi snzi_object; //! The underlying SNZI object
+		std::unique_ptr<slot[]> slots; //! The slot of each thread
+		size_type total_threads; //! Number of threads to use this SNZI object
+
+		/**
+		 * Departs on behalf of the thread with identifier tid if it has a parked arrival.
+		 *
+		 * \return True if the thread had a parked arrival.
+		 */
+		bool revoke(size_type tid){
+			slot& s = slots[tid];
+
+			int status = parked;
+			if (!s.status.compare_exchange_strong(status, revoking, std::memory_order_acq_rel, std::memory_order_relaxed)){
+				return false;
+			}
+
+			snzi_thread_traits<Snzi>::depart(snzi_object, tid, s.state);
+			s.status.store(idle, std::memory_order_release);
+			return true;
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* BIASED_SNZI_HPP_ */
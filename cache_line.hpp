@@ -0,0 +1,20 @@
+#ifndef CACHE_LINE_HPP_
+#define CACHE_LINE_HPP_
+
+#include <cstddef>
+#include "config.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Padding modes for the layout policies (see snzi_layout.hpp).
+	 */
+	enum padding_size : std::size_t{
+		line_padding = 64, //! One cache line
+		adjacent_line_padding = 128, //! A pair of cache lines, for parts with the adjacent-line prefetcher
+		sector_padding = 256 //! Four cache lines, for parts that prefetch larger sectors
+	};
+
+} // namespace concurrent
+
+#endif /* CACHE_LINE_HPP_ */
@@ -0,0 +1,269 @@
+#ifndef COMBINING_COUNTER_HPP_
+#define COMBINING_COUNTER_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <atomic>
+#include "backoff.hpp"
+#include "config.hpp"
+#include "snzi_arena.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class combining_counter implements an exact shared counter whose fetch_add() returns the previous value, as a software combining
+	 * tree on the tree of the SNZI objects: the same shapes (see tree_shape), the same assignment of threads to leaves as in snzi.hpp and
+	 * the same padded node arrays (which may live in a snzi_arena).
+	 *
+	 * The algorithm is the combining tree of M. Herlihy and N. Shavit, The Art of Multiprocessor Programming, chapter 12. A thread climbs
+	 * from its leaf and stops at the first node where another thread got first; the two requests are combined there, and the first thread
+	 * carries their sum upwards, so only one request per busy subtree reaches the root. The root adds the sum to the counter and the
+	 * previous value is distributed back down the paths, each thread receiving the value that precedes its own part of the sum. Each node
+	 * combines at most two requests at a time; a third thread waits for the node to be released.
+	 *
+	 * Every node is a monitor guarded by a spin lock of its own, and the waits of the algorithm back off with exponential_backoff. Combining
+	 * only pays off when many threads increment at once: a thread alone in the tree makes 3H+2 lock acquisitions per operation (precombine
+	 * on the H+1 nodes of its path, combine on the H nodes below the root, op at the root and distribute on the H nodes again), so at low
+	 * concurrency a plain std::atomic fetch_add is faster (see snzi_perf_eval_combining_counter.cpp).
+	 */
+	class combining_counter{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+		using value_type = std::uint64_t; //! The type of the counter
+
+		static const size_type max_height = 64; //! The greatest height of the tree
+
+	private:
+		enum class combining_status{ idle, first, second, result, root };
+
+		struct node{
+			// to avoid false sharing with other nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<bool> monitor; //! The spin lock of the monitor; the fields below are guarded by it
+			bool locked{false}; //! Set while a combined request passes through the node
+			combining_status status{combining_status::idle};
+			value_type first_value{0}; //! The request of the first thread, including what it combined below
+			value_type second_value{0}; //! The request of the second thread
+			value_type result{0}; //! The counter at the root; the value for the second thread elsewhere
+			size_type parent{0};
+
+			node(){
+				monitor.store(false, std::memory_order_relaxed);
+			}
+
+			void enter(){
+				exponential_backoff backoff;
+				while (monitor.exchange(true, std::memory_order_acquire)){
+					backoff.backoff();
+				}
+			}
+
+			void leave(){
+				monitor.store(false, std::memory_order_release);
+			}
+
+			// leaves the monitor for a while, so that other threads can change the state
+			void wait(exponential_backoff& backoff){
+				leave();
+				backoff.backoff();
+				enter();
+			}
+
+			/**
+			 * \return True if the thread got first at this node and should climb further.
+			 */
+			bool precombine(){
+				enter();
+				exponential_backoff backoff;
+				// with more than two threads per leaf or more than two children a third thread can find the node second but unlocked,
+				// between the op() of the second thread and the combine() of the first, so it waits until the pair is done
+				while (locked || status == combining_status::second){
+					wait(backoff);
+				}
+
+				bool climb = false;
+				switch (status){
+				case combining_status::idle:
+					status = combining_status::first;
+					climb = true;
+					break;
+				case combining_status::first:
+					locked = true;
+					status = combining_status::second;
+					break;
+				default: // root
+					break;
+				}
+
+				leave();
+				return climb;
+			}
+
+			/**
+			 * Adds the request of the second thread, if any, to combined and locks the node for the way up.
+			 */
+			value_type combine(value_type combined){
+				enter();
+				exponential_backoff backoff;
+				while (locked){
+					wait(backoff);
+				}
+				locked = true;
+				first_value = combined;
+
+				const value_type total = status == combining_status::second ? first_value + second_value : first_value;
+
+				leave();
+				return total;
+			}
+
+			/**
+			 * Applies combined at the root, or hands it to the first thread at the node where this thread stopped and waits for the result.
+			 */
+			value_type op(value_type combined){
+				enter();
+
+				if (status == combining_status::root){
+					const value_type prior = result;
+					result += combined;
+					leave();
+					return prior;
+				}
+
+				// second
+				second_value = combined;
+				locked = false;
+				exponential_backoff backoff;
+				while (status != combining_status::result){
+					wait(backoff);
+				}
+				locked = false;
+				status = combining_status::idle;
+				const value_type prior = result;
+
+				leave();
+				return prior;
+			}
+
+			/**
+			 * Releases the node on the way down, giving the waiting second thread its value if there is one.
+			 */
+			void distribute(value_type prior){
+				enter();
+
+				if (status == combining_status::first){
+					status = combining_status::idle;
+					locked = false;
+				}
+				else{
+					// second
+					result = prior + first_value;
+					status = combining_status::result;
+				}
+
+				leave();
+			}
+		};
+
+	public:
+
+		/**
+		 * Constructs a counter with the value 0 on a perfect K-ary tree with height H. T specifies the maximum number of threads that will use
+		 * the counter; two threads per leaf (K=2 and 2^H = T/2) is the classic configuration.
+		 *
+		 * \throws std::invalid_argument If K is lower than 2 or H exceeds max_height.
+		 */
+		combining_counter(size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : combining_counter(tree_shape::uniform(K,H), T, arena){}
+
+		/**
+		 * Constructs a counter with the value 0 on a tree with the given shape. T specifies the maximum number of threads that will use the
+		 * counter. The nodes are allocated from arena (see snzi_arena.hpp), which must outlive the counter, or from the heap if arena is nullptr.
+		 *
+		 * \throws std::invalid_argument If the height of shape exceeds max_height.
+		 */
+		combining_counter(const tree_shape& shape, size_type T, snzi_arena* arena = nullptr){
+			if (shape.height() > max_height){
+				throw std::invalid_argument("height of the tree in combining_counter constructor must be <= max_height");
+			}
+
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
+			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			total_threads = T;
+
+			nodes = make_node_array<node>(arena, total_nodes);
+			nodes[0].status = combining_status::root;
+			for (size_type i = 1; i < total_nodes; ++i){
+				nodes[i].parent = shape.parent(i);
+			}
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to add value to the counter.
+		 *
+		 * \return The value of the counter just before value was added.
+		 */
+		value_type fetch_add(size_type tid, value_type value){
+			const size_type leaf = get_leaf_for_thread(tid);
+
+			// precombining: find the node where the thread stops
+			size_type stop = leaf;
+			while (nodes[stop].precombine()){
+				stop = nodes[stop].parent;
+			}
+
+			// combining: lock the path below stop and collect the requests of the second threads
+			size_type path[max_height];
+			size_type length = 0;
+			value_type combined = value;
+			for (size_type id = leaf; id != stop; id = nodes[id].parent){
+				assert(length < max_height);
+				combined = nodes[id].combine(combined);
+				path[length++] = id;
+			}
+
+			// operation
+			const value_type prior = nodes[stop].op(combined);
+
+			// distribution, from the top down
+			while (length){
+				nodes[path[--length]].distribute(prior);
+			}
+
+			return prior;
+		}
+
+		/**
+		 * \return The value of the counter, which includes every fetch_add() that has returned.
+		 */
+		value_type load(){
+			nodes[0].enter();
+			const value_type value = nodes[0].result;
+			nodes[0].leave();
+			return value;
+		}
+
+	private:
+		size_type total_nodes; //! Total number on nodes in the tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this counter
+		node_array<node> nodes{nullptr}; //! The nodes of the tree in level order; nodes[0] is the root
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (as in snzi.hpp).
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* COMBINING_COUNTER_HPP_ */
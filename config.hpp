@@ -1,6 +1,25 @@
 #ifndef CONFIG_HPP_
 #define CONFIG_HPP_
 
+#include <new>
+
+/**
+ * CACHE_LINE_SIZE is the padding (in bytes) used to keep SNZI nodes from sharing cache lines. It is chosen per build:
+ * 			+ -DCACHE_LINE_SIZE=<bytes> sets it explicitly.
+ * 			+ -DSNZI_ADJACENT_LINE_PREFETCH pads to 128 bytes. On Intel parts the adjacent-line (spatial) prefetcher fetches lines in
+ * 			  128-byte aligned pairs, so 64-byte padding still causes false sharing between neighboring nodes.
+ * 			+ -DSNZI_HARDWARE_INTERFERENCE_SIZE uses std::hardware_destructive_interference_size when the standard library provides it (C++17).
+ * Otherwise 64 bytes are used. The layout policies of snzi_layout.hpp can select a different padding per SNZI object (see
+ * padding_size in cache_line.hpp). The padding is fixed at compile time because it sets the alignment of the node types.
+ */
+#ifndef CACHE_LINE_SIZE
+#if defined(SNZI_HARDWARE_INTERFERENCE_SIZE) && defined(__cpp_lib_hardware_interference_size)
+#define CACHE_LINE_SIZE std::hardware_destructive_interference_size
+#elif defined(SNZI_ADJACENT_LINE_PREFETCH)
+#define CACHE_LINE_SIZE 128
+#else
 #define CACHE_LINE_SIZE 64
+#endif
+#endif
 
 #endif
@@ -0,0 +1,113 @@
+#ifndef DEPARTURE_HYSTERESIS_HPP_
+#define DEPARTURE_HYSTERESIS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "backoff.hpp"
+#include "config.hpp"
+
+namespace concurrent{
+
+	/**
+	 * The hysteresis policy of the departures of a SNZI tree (see set_departure_hysteresis() in snzi.hpp).
+	 *
+	 * A node whose counter goes from 1 to 0 normally departs from its parent at once, and the next Arrive operation at the node arrives
+	 * at the parent again. With hysteresis the node holds on to its arrival at the parent instead, and an Arrive operation that finds the
+	 * node 0 takes the held arrival back without touching the parent. A held arrival is released (the node departs from its parent):
+	 * 			+ by the next Depart operation that takes the node to 0 after max_rearrivals consecutive take-backs, if max_rearrivals is not 0;
+	 * 			+ by a query that finds the tree nonzero once it has been held for staleness_ns nanoseconds; the queries look for stale held
+	 * 			  arrivals at most once per staleness_ns;
+	 * 			+ by QueryAccurate(), whatever its age.
+	 * A held arrival is still counted by the parent, so Query() may report a surplus made only of held arrivals, for less than twice
+	 * staleness_ns after the last Depart operation.
+	 */
+	struct departure_hysteresis{
+		std::uint64_t staleness_ns{0}; //! How long a node may hold its arrival at the parent; 0 disables the hysteresis
+		std::size_t max_rearrivals{0}; //! How many times in a row a held arrival may be taken back before it is released; 0 for no limit
+
+		departure_hysteresis() = default;
+		departure_hysteresis(std::uint64_t staleness_ns, std::size_t max_rearrivals = 0) : staleness_ns(staleness_ns), max_rearrivals(max_rearrivals){}
+
+		/**
+		 * \return True if the nodes hold their arrivals at their parents.
+		 */
+		bool enabled() const{
+			return staleness_ns != 0;
+		}
+	};
+
+	/**
+	 * The arrival at its parent that a node holds after its counter went to 0. The word holds the time stamp counter when the arrival was
+	 * held (with the low bit set, so that it is never 0), or 0 if the node holds nothing. Whoever takes the word from nonzero to 0 owns the
+	 * arrival: an Arrive operation keeps it, a releaser departs from the parent.
+	 */
+	class held_arrival{
+	public:
+		held_arrival(){
+			reset();
+		}
+
+		/**
+		 * Called by the operation that took the counter of the node to 0, instead of departing from the parent.
+		 *
+		 * \return True if the arrival is now held; false if the node already holds one or the take-backs reached max_rearrivals, in
+		 * which case the caller departs from the parent.
+		 */
+		bool hold(std::size_t max_rearrivals){
+			if (max_rearrivals && rearrivals.load(std::memory_order_relaxed) >= max_rearrivals){
+				rearrivals.store(0, std::memory_order_relaxed);
+				return false;
+			}
+
+			std::uint64_t expected = 0;
+			return since.compare_exchange_strong(expected, backoff_detail::rdtsc() | 1, std::memory_order_release, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Called by an Arrive operation that would arrive at the parent.
+		 *
+		 * \return True if it took the held arrival back, in which case the parent already counts the node.
+		 */
+		bool take(){
+			if (!since.load(std::memory_order_relaxed) || !since.exchange(0, std::memory_order_acquire)){
+				return false;
+			}
+			rearrivals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/**
+		 * Takes the held arrival for a releaser if it was held before stale_before (time stamp counter) or at or after fresh_from.
+		 *
+		 * \return True if the caller must depart from the parent, in which case the take-backs start over.
+		 */
+		bool release(std::uint64_t stale_before, std::uint64_t fresh_from){
+			std::uint64_t held = since.load(std::memory_order_relaxed);
+			if (!held || (held >= stale_before && held < fresh_from)){
+				return false;
+			}
+			if (!since.compare_exchange_strong(held, 0, std::memory_order_acquire, std::memory_order_relaxed)){
+				return false;
+			}
+			rearrivals.store(0, std::memory_order_relaxed);
+			return true;
+		}
+
+		/**
+		 * Forgets the held arrival and the take-backs, for a quiescent tree whose counters are cleared.
+		 */
+		void reset(){
+			since.store(0, std::memory_order_relaxed);
+			rearrivals.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		// to avoid false sharing with the held arrivals of other nodes
+		alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> since; //! When the arrival was held, or 0
+		std::atomic<std::size_t> rearrivals; //! Take-backs since the node last departed from its parent
+	};
+
+} // namespace concurrent
+
+#endif /* DEPARTURE_HYSTERESIS_HPP_ */
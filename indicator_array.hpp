@@ -0,0 +1,322 @@
+#ifndef INDICATOR_ARRAY_HPP_
+#define INDICATOR_ARRAY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "root_observer.hpp"
+#include "snzi_arena.hpp"
+#include "snzi.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class indicator_array holds N SNZI objects of type Snzi (one per object of a lock manager, for example) together with a dense
+	 * bitmap whose bit i mirrors Query() of indicator i. The bitmap is maintained on the transitions of the roots (see root_observer.hpp),
+	 * so the operations of the indicators only pay for it when their root goes between 0 and nonzero, and a scan of all the indicators reads
+	 * N/8 bytes instead of N padded cache lines.
+	 *
+	 * QueryAll() copies the bitmap and FindFirstNonZero() searches it; both use AVX-512 or AVX2 when the translation unit is compiled for
+	 * them (-mavx512f or -mavx2) and plain 64-bit words otherwise. The bitmap is padded to whole cache lines so the vector loops have no tail.
+	 *
+	 * The bit of an indicator is a mirror, not the indicator itself. After a transition of the root, the thread that made it sets or clears
+	 * the bit and then queries the root again, repeating until the two agree, so the bit is exact whenever no transition of the indicator is
+	 * in progress and lags by at most the transitions in progress otherwise. Each word of the bitmap is read atomically, but a scan is not
+	 * a snapshot of the whole bitmap. Query(i) reads the root of indicator i and is exact.
+	 *
+	 * Above the bitmap there is a hierarchical summary: bit j of summary level 1 tells whether word j of the bitmap is nonzero, bit j of level
+	 * 2 whether word j of level 1 is nonzero and so on, up to a level of a single word (three levels for a million indicators). A summary bit
+	 * is mirrored like a bitmap bit, by the thread whose change took the word below between zero and nonzero, so the summary is only written
+	 * on the rare transitions of the roots. AnyNonZero() reads the top word and FindNextNonZero() descends the summary, so both touch
+	 * O(levels) cache lines instead of scanning the bitmap.
+	 *
+	 * Snzi must be one of the classes of snzi.hpp (which notify a root_observer and are movable) and constructible from (K,H,T,arena). The indicators
+	 * are stored by value, next to each other.
+	 */
+	template<typename Snzi>
+	class indicator_array{
+	public:
+		using size_type = std::size_t; //! For sizes, indices and thread identifiers
+		using bitmap_word = std::uint64_t; //! A word of the bitmap; bit i%64 of word i/64 is the bit of indicator i
+
+		static const size_type npos = ~size_type(0); //! Returned by FindFirstNonZero() if no indicator is nonzero
+		static const size_type bits_per_word = 64; //! Indicators per word of the bitmap
+
+		/**
+		 * Constructs N SNZI objects with the parameters K, H and T, all of them initially zero. Their nodes are allocated from arena (see
+		 * snzi_arena.hpp), which must outlive the indicator_array, or from the heap if arena is nullptr.
+		 *
+		 * \throws invalid_argument If the SNZI objects reject the parameters.
+		 */
+		indicator_array(size_type N, size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : total_indicators(N){
+			total_blocks = (N + bits_per_block - 1)/bits_per_block;
+			blocks.reset(new block[total_blocks ? total_blocks : 1]);
+
+			level_words.push_back(bitmap_words());
+			while (level_words.back() > 1){
+				const size_type words = (level_words.back() + bits_per_word - 1)/bits_per_word;
+				level_words.push_back(words);
+				summaries.emplace_back(new std::atomic<bitmap_word>[words]);
+				for (size_type w = 0; w < words; ++w){
+					summaries.back()[w].store(0, std::memory_order_relaxed);
+				}
+			}
+
+			indicators.reserve(N);
+			for (size_type i = 0; i < N; ++i){
+				indicators.emplace_back(K, H, T, arena);
+
+				root_observer observer;
+				observer.transition = &indicator_array::on_root_transition;
+				observer.context = this;
+				observer.index = i;
+				indicators.back().set_root_observer(observer);
+			}
+		}
+
+		indicator_array(const indicator_array&) = delete;
+		indicator_array& operator=(const indicator_array&) = delete;
+
+		/**
+		 * \return The number of indicators.
+		 */
+		size_type size() const{
+			return total_indicators;
+		}
+
+		/**
+		 * \return The number of words of the bitmap that QueryAll() fills.
+		 */
+		size_type bitmap_words() const{
+			return (total_indicators + bits_per_word - 1)/bits_per_word;
+		}
+
+		/**
+		 * \return The indicator with index i, on which the threads call Arrive and Depart as usual.
+		 */
+		Snzi& operator[](size_type i){
+			return indicators[i];
+		}
+
+		/**
+		 * \return The result of Query() on the indicator with index i.
+		 */
+		bool Query(size_type i) const{
+			return indicators[i].Query();
+		}
+
+		/**
+		 * Copies the bitmap into out_bitmap, which is resized to bitmap_words() words.
+		 */
+		void QueryAll(std::vector<bitmap_word>& out_bitmap) const{
+			out_bitmap.resize(bitmap_words());
+
+			const size_type words = bitmap_words();
+			size_type i = 0;
+#if defined(__AVX512F__)
+			for (; i + 8 <= words; i += 8){
+				_mm512_storeu_si512(reinterpret_cast<__m512i*>(&out_bitmap[i]), _mm512_load_si512(raw_words() + i));
+			}
+#elif defined(__AVX2__)
+			for (; i + 4 <= words; i += 4){
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(&out_bitmap[i]), _mm256_load_si256(reinterpret_cast<const __m256i*>(raw_words() + i)));
+			}
+#endif
+			for (; i < words; ++i){
+				out_bitmap[i] = word(i).load(std::memory_order_acquire);
+			}
+		}
+
+		/**
+		 * \return The index of the first indicator whose bit is set, or npos if there is none.
+		 */
+		size_type FindFirstNonZero() const{
+			const size_type words = total_blocks*words_per_block;
+			size_type i = 0;
+#if defined(__AVX512F__)
+			for (; i < words; i += 8){
+				const __m512i v = _mm512_load_si512(raw_words() + i);
+				if (_mm512_test_epi64_mask(v, v)){
+					const size_type found = first_set_from(i, i + 8);
+					if (found != npos){
+						return found;
+					}
+				}
+			}
+#elif defined(__AVX2__)
+			for (; i < words; i += 4){
+				const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(raw_words() + i));
+				if (!_mm256_testz_si256(v, v)){
+					const size_type found = first_set_from(i, i + 4);
+					if (found != npos){
+						return found;
+					}
+				}
+			}
+#endif
+			return first_set_from(i, words);
+		}
+
+		/**
+		 * \return True if the bit of some indicator is set, read from the top word of the summary.
+		 */
+		bool AnyNonZero() const{
+			return level_word(level_words.size() - 1, 0).load(std::memory_order_acquire) != 0;
+		}
+
+		/**
+		 * \return The index of the first indicator after i whose bit is set, or npos if there is none.
+		 */
+		size_type FindNextNonZero(size_type i) const{
+			if (i + 1 >= total_indicators){
+				return npos;
+			}
+			return find_from(0, i + 1);
+		}
+
+	private:
+		static const size_type words_per_block = CACHE_LINE_SIZE/sizeof(bitmap_word); //! Words of the bitmap per cache line
+		static const size_type bits_per_block = words_per_block*bits_per_word; //! Indicators per cache line of the bitmap
+
+		static_assert(sizeof(std::atomic<bitmap_word>) == sizeof(bitmap_word), "the words of the bitmap are loaded as plain words by the scans");
+		static_assert(words_per_block % 8 == 0, "the vector loops of the scans need cache lines of at least 64 bytes");
+
+		struct block{
+			alignas(CACHE_LINE_SIZE) std::atomic<bitmap_word> words[words_per_block];
+
+			block(){
+				for (std::atomic<bitmap_word>& w : words){
+					w.store(0, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		size_type total_indicators; //! The number of indicators
+		size_type total_blocks; //! The number of cache lines of the bitmap
+		std::unique_ptr<block[]> blocks; //! The bitmap
+		std::vector<Snzi> indicators; //! The indicators
+		std::vector<size_type> level_words; //! The number of words of each level; level 0 is the bitmap and the last level has one word
+		std::vector<std::unique_ptr<std::atomic<bitmap_word>[]> > summaries; //! summaries[l-1] holds the words of summary level l
+
+		std::atomic<bitmap_word>& word(size_type w) const{
+			return blocks[w/words_per_block].words[w%words_per_block];
+		}
+
+		std::atomic<bitmap_word>& level_word(size_type level, size_type w) const{
+			return level ? summaries[level - 1][w] : word(w);
+		}
+
+		const bitmap_word* raw_words() const{
+			return reinterpret_cast<const bitmap_word*>(blocks.get());
+		}
+
+		/**
+		 * \return The index of the first indicator whose bit is set in the words [first,last), or npos if there is none.
+		 */
+		size_type first_set_from(size_type first, size_type last) const{
+			for (size_type w = first; w < last; ++w){
+				const bitmap_word x = word(w).load(std::memory_order_acquire);
+				if (x){
+					return w*bits_per_word + static_cast<size_type>(__builtin_ctzll(x));
+				}
+			}
+			return npos;
+		}
+
+		/**
+		 * \return The first position at or after pos whose bit is set in the given level, or npos if there is none.
+		 */
+		size_type find_from(size_type level, size_type pos) const{
+			for (;;){
+				const size_type w = pos/bits_per_word;
+				if (w >= level_words[level]){
+					return npos;
+				}
+
+				const bitmap_word x = level_word(level, w).load(std::memory_order_acquire) & (~bitmap_word(0) << (pos%bits_per_word));
+				if (x){
+					return w*bits_per_word + static_cast<size_type>(__builtin_ctzll(x));
+				}
+
+				// ask the level above for the next nonzero word
+				if (level + 1 == level_words.size()){
+					return npos;
+				}
+				const size_type next = find_from(level + 1, w + 1);
+				if (next == npos){
+					return npos;
+				}
+				// the summary bit may be stale, in which case the search goes on after that word
+				pos = next*bits_per_word;
+			}
+		}
+
+		/**
+		 * Makes the bit of word w of the given level agree with that word, in the level above.
+		 */
+		void mirror_summary(size_type level, size_type w){
+			std::atomic<bitmap_word>& above = level_word(level + 1, w/bits_per_word);
+			const bitmap_word bit = bitmap_word(1) << (w%bits_per_word);
+
+			bool nonzero = level_word(level, w).load(std::memory_order_acquire) != 0;
+			for (;;){
+				set_bit(level + 1, w/bits_per_word, above, bit, nonzero);
+
+				const bool now = level_word(level, w).load(std::memory_order_acquire) != 0;
+				if (now == nonzero){
+					return ;
+				}
+				nonzero = now;
+			}
+		}
+
+		/**
+		 * Sets or clears bit in word w of the given level and, if the word went between zero and nonzero, mirrors it in the level above.
+		 */
+		void set_bit(size_type level, size_type w, std::atomic<bitmap_word>& word, bitmap_word bit, bool value){
+			const bitmap_word old = value ? word.fetch_or(bit, std::memory_order_acq_rel) : word.fetch_and(~bit, std::memory_order_acq_rel);
+			const bitmap_word now = value ? old | bit : old & ~bit;
+
+			if ((!old != !now) && level + 1 < level_words.size()){
+				mirror_summary(level, w);
+			}
+		}
+
+		static void on_root_transition(void* context, std::size_t index){
+			static_cast<indicator_array*>(context)->mirror(index);
+		}
+
+		/**
+		 * Makes the bit of indicator i agree with its root.
+		 */
+		void mirror(size_type i){
+			std::atomic<bitmap_word>& w = word(i/bits_per_word);
+			const bitmap_word bit = bitmap_word(1) << (i%bits_per_word);
+
+			bool nonzero = indicators[i].Query();
+			for (;;){
+				set_bit(0, i/bits_per_word, w, bit, nonzero);
+
+				// a transition that happened meanwhile may have been mirrored before ours
+				const bool now = indicators[i].Query();
+				if (now == nonzero){
+					return ;
+				}
+				nonzero = now;
+			}
+		}
+	};
+
+	template<typename Snzi> const std::size_t indicator_array<Snzi>::npos;
+	template<typename Snzi> const std::size_t indicator_array<Snzi>::bits_per_word;
+	template<typename Snzi> const std::size_t indicator_array<Snzi>::words_per_block;
+	template<typename Snzi> const std::size_t indicator_array<Snzi>::bits_per_block;
+
+} // namespace concurrent
+
+#endif /* INDICATOR_ARRAY_HPP_ */
@@ -0,0 +1,216 @@
+#ifndef INDICATOR_FOREST_HPP_
+#define INDICATOR_FOREST_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <atomic>
+#include "arrival_token.hpp"
+#include "config.hpp"
+#include "snzi_arena.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class indicator_forest holds N SNZI objects (one per lock, for example) that are used by the same T threads. The topology and
+	 * the mapping of the threads are computed once for the whole family, and each indicator keeps only its own root and leaves.
+	 *
+	 * The forest is built on a shape that follows the machine (for example {sockets, cores per socket, threads per core}, see tree_shape)
+	 * and a leaf depth. The leaves of every indicator are the nodes of that level of the shape, and each thread is mapped once, in the
+	 * constructor, to the node of that level above its leaf in the full shape. Arrive and Depart then cost a table lookup to find the
+	 * leaf of the thread. A leaf that goes between 0 and nonzero propagates straight to the root of its indicator.
+	 *
+	 * The counters of interior nodes cannot be shared between indicators: a shared node would count the arrivals of every indicator below it,
+	 * and could not tell which roots to propagate to. So the forest drops the interior levels instead of sharing them. An indicator takes
+	 * 1 + level_size(leaf_depth) padded nodes instead of nodes(), and all of them lie in one contiguous block of the storage. The price is
+	 * that up to level_size(leaf_depth) leaves propagate to the same root, so the leaf depth should be a level with few nodes that still
+	 * separates the threads that contend, for example the cores or the sockets. The algorithm of the nodes is the one of
+	 * no_contention_handling_snzi.
+	 */
+	class indicator_forest{
+	public:
+		using size_type = std::size_t; //! For sizes, indices and thread identifiers
+
+	private:
+		using counter_type = std::uint64_t; //! Type used for the counter at each SNZI node
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+
+			node(){
+				X.store(0, snzi_order::init);
+			}
+		};
+
+	public:
+
+		/**
+		 * Constructs N indicators whose leaves are the nodes of the last level of a perfect K-ary tree of height H, for T threads.
+		 *
+		 * \throws std::invalid_argument If K is lower than 2.
+		 */
+		indicator_forest(size_type N, size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) :
+			indicator_forest(N, tree_shape::uniform(K,H), H, T, arena){}
+
+		/**
+		 * Constructs N indicators for T threads, whose leaves are the nodes of level leaf_depth of shape.
+		 *
+		 * \param N The number of indicators
+		 * \param shape The shape whose leaves the threads are assigned to, as in snzi.hpp
+		 * \param leaf_depth The level of shape whose nodes are the leaves of the indicators; 0 makes the threads arrive at the roots
+		 * \param T The number of threads to use the indicators
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), which must outlive the forest, or nullptr for the heap
+		 * \throws std::invalid_argument If leaf_depth exceeds the height of shape.
+		 */
+		indicator_forest(size_type N, const tree_shape& shape, size_type leaf_depth, size_type T, snzi_arena* arena = nullptr) :
+			total_indicators(N){
+			if (leaf_depth > shape.height()){
+				throw std::invalid_argument("leaf_depth in indicator_forest constructor must be <= the height of the shape");
+			}
+
+			leaves_per_indicator = leaf_depth ? shape.level_size(leaf_depth) : 0;
+			nodes_per_indicator = 1 + leaves_per_indicator;
+
+			// the mapping of snzi.hpp to the leaves of the full shape, then up to leaf_depth
+			size_type threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)shape.leaves()));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			thread_slot.resize(T);
+			for (size_type tid = 0; tid < T; ++tid){
+				size_type id = shape.nodes() - shape.leaves() + ((tid/threads_per_leaf)%shape.leaves());
+				while (shape.depth(id) > leaf_depth){
+					id = shape.parent(id);
+				}
+				thread_slot[tid] = leaf_depth ? 1 + id - shape.level_offset(leaf_depth) : 0;
+			}
+
+			nodes = make_node_array<node>(arena, total_indicators*nodes_per_indicator);
+		}
+
+		/**
+		 * \return The number of indicators.
+		 */
+		size_type size() const{
+			return total_indicators;
+		}
+
+		/**
+		 * \return The number of padded nodes that each indicator takes.
+		 */
+		size_type nodes_per_tree() const{
+			return nodes_per_indicator;
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence in indicator i.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation on the same indicator, either by the same thread with
+		 * Depart(i, tid) or by any thread with Depart(i, token).
+		 *
+		 * \return The token that identifies the node of indicator i at which the thread arrived.
+		 */
+		arrival_token Arrive(size_type i, size_type tid){
+			assert(tid < thread_slot.size());
+
+			const size_type slot = thread_slot[tid];
+			arrive_at(i, slot);
+			return arrival_token(slot);
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), after it has called Arrive(i, tid) to declare that
+		 * it "departs" from indicator i.
+		 */
+		void Depart(size_type i, size_type tid){
+			assert(tid < thread_slot.size());
+
+			depart_at(i, thread_slot[tid]);
+		}
+
+		/**
+		 * Departs from the node of indicator i at which the Arrive() operation that returned token arrived.
+		 */
+		void Depart(size_type i, arrival_token token){
+			depart_at(i, token.node());
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in indicator i.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations on indicator i.
+		 */
+		bool Query(size_type i) const{
+			return tree(i)[0].X.load(snzi_order::query) != 0;
+		}
+
+	private:
+		size_type total_indicators; //! The number of indicators
+		size_type leaves_per_indicator; //! The number of leaves of each indicator
+		size_type nodes_per_indicator; //! The root and the leaves of each indicator
+		std::vector<size_type> thread_slot; //! thread_slot[tid] is the node of every indicator at which thread tid arrives (0 is the root)
+		node_array<node> nodes{nullptr}; //! The nodes of indicator i are [i*nodes_per_indicator, (i+1)*nodes_per_indicator)
+
+		node* tree(size_type i){
+			assert(i < total_indicators);
+			return &nodes[i*nodes_per_indicator];
+		}
+
+		const node* tree(size_type i) const{
+			assert(i < total_indicators);
+			return &nodes[i*nodes_per_indicator];
+		}
+
+		void arrive_at(size_type i, size_type slot){
+			node* t = tree(i);
+
+			if (!slot){
+				t[0].X.fetch_add(1, snzi_order::root_arrive);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = t[slot].X;
+			bool pArrInv = false;
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			do{
+				if (!oldx && !pArrInv){
+					t[0].X.fetch_add(1, snzi_order::root_arrive);
+					pArrInv = true;
+				}
+			} while (!X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure));
+
+			if (pArrInv && oldx){
+				t[0].X.fetch_sub(1, snzi_order::root_depart);
+			}
+		}
+
+		void depart_at(size_type i, size_type slot){
+			node* t = tree(i);
+
+			if (slot){
+				std::atomic<counter_type>& X = t[slot].X;
+
+				counter_type oldx = X.load(snzi_order::probe);
+
+				while (!X.compare_exchange_weak(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure)){}
+
+				if (oldx != 1){
+					return ;
+				}
+			}
+
+			t[0].X.fetch_sub(1, snzi_order::root_depart);
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* INDICATOR_FOREST_HPP_ */
@@ -0,0 +1,227 @@
+#ifndef MULTI_LANE_SNZI_HPP_
+#define MULTI_LANE_SNZI_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <memory>
+#include <atomic>
+#include "config.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class multi_lane_snzi implements Lanes independent SNZI objects that share one tree: the 64-bit word of every node packs one counter
+	 * per indicator (a lane of 64/Lanes bits), for example the read, write and upgrade intents on the same resource. The algorithm of each lane
+	 * is the one of no_contention_handling_snzi.
+	 *
+	 * The operations take a lane mask, in which bit i selects lane i, and act on all the selected lanes at once: a node is changed by a single
+	 * CAS that adds or subtracts the packed increments of the lanes (SWAR arithmetic), so an operation on several indicators touches one
+	 * cache line per level instead of one per level and indicator. The 0 to 1 and 1 to 0 transitions are tracked per lane, and only the lanes
+	 * that went through one are propagated to the parent, again with a single CAS for all of them.
+	 *
+	 * A lane never carries into its neighbour as long as no counter exceeds max_lane_count. Every thread holds at most one arrival per lane
+	 * (nested arrivals can be counted by a re-entrant handle, see snzi_handle.hpp), but the lane of an interior node or of the root briefly
+	 * counts every thread of its subtree that found a child at 0 and arrived at it, on top of the children that are nonzero, so its count is
+	 * bounded only by the number of threads of the subtree. The constructor therefore requires T to be at most max_lane_count.
+	 */
+	template<std::size_t Lanes = 4>
+	class multi_lane_snzi{
+		static_assert(Lanes == 2 || Lanes == 4 || Lanes == 8, "Lanes of multi_lane_snzi must be 2, 4 or 8");
+
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+		using lane_mask = unsigned int; //! Bit i selects lane i
+
+		static const size_type lane_count = Lanes; //! The number of indicators
+		static const size_type lane_bits = 64/Lanes; //! The width of the counter of a lane
+		static const size_type max_lane_count = (size_type(1) << lane_bits) - 1; //! The largest count of a lane
+		static const lane_mask all_lanes = (1u << Lanes) - 1; //! Selects every lane
+
+	private:
+		using counter_type = std::uint64_t; //! Type of the word of each SNZI node
+
+		static const counter_type lane_low_bits = ~counter_type(0)/max_lane_count; //! The lowest bit of every lane
+		static const counter_type lane_high_bits = lane_low_bits << (lane_bits - 1); //! The highest bit of every lane
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			size_type parent;
+
+			node(){
+				X.store(0, snzi_order::init);
+			}
+		};
+
+	public:
+
+		/**
+		 * Constructs the indicators on a perfect K-ary tree with height H. T specifies the maximum number of threads that will use them.
+		 *
+		 * \throws std::invalid_argument If K is lower than 2, or if T exceeds max_lane_count.
+		 */
+		multi_lane_snzi(size_type K, size_type H, size_type T) : multi_lane_snzi(tree_shape::uniform(K,H), T){}
+
+		/**
+		 * Constructs the indicators on a tree with the given shape. T specifies the maximum number of threads that will use them.
+		 *
+		 * \throws std::invalid_argument If T exceeds max_lane_count.
+		 */
+		multi_lane_snzi(const tree_shape& shape, size_type T) : shape(shape){
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
+			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			total_threads = T;
+
+			// a lane of any node counts at most the threads of its subtree
+			if (T > max_lane_count){
+				throw std::invalid_argument("T in multi_lane_snzi constructor must fit in a lane");
+			}
+
+			nodes.reset(new node[total_nodes]);
+			for (size_type i = 1; i < total_nodes; ++i){
+				nodes[i].parent = shape.parent(i);
+			}
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence in the indicators selected by
+		 * lanes.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation with the same lanes.
+		 */
+		void Arrive(size_type tid, lane_mask lanes){
+			arrive_at(get_leaf_for_thread(tid), lanes);
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), after it has called Arrive() to declare that it
+		 * "departs" from the indicators selected by lanes.
+		 */
+		void Depart(size_type tid, lane_mask lanes){
+			depart_at(get_leaf_for_thread(tid), lanes);
+		}
+
+		/**
+		 * \return True is there is a surplus of Arrive operations from Depart operations in the given lane.
+		 */
+		bool Query(size_type lane) const{
+			return ((nodes[0].X.load(snzi_order::query) >> (lane*lane_bits)) & max_lane_count) != 0;
+		}
+
+		/**
+		 * \return The mask of the lanes with a surplus of Arrive operations from Depart operations, read at once.
+		 */
+		lane_mask QueryAll() const{
+			return nonzero_lanes(nodes[0].X.load(snzi_order::query));
+		}
+
+	private:
+		tree_shape shape; //! The shape of the SNZI tree
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this SNZI object
+		std::unique_ptr<node[]> nodes{nullptr}; //! The SNZI nodes of the tree in level order; nodes[0] is the root
+
+		/**
+		 * \return The word that adds 1 to each lane selected by lanes.
+		 */
+		static counter_type increments(lane_mask lanes){
+			counter_type inc = 0;
+			for (size_type i = 0; i < Lanes; ++i){
+				if (lanes & (1u << i)){
+					inc |= counter_type(1) << (i*lane_bits);
+				}
+			}
+			return inc;
+		}
+
+		/**
+		 * \return The mask of the nonzero lanes of x.
+		 */
+		static lane_mask nonzero_lanes(counter_type x){
+			// adding the largest value below the high bit to the other bits of a lane carries into the high bit iff they are nonzero,
+			// and never into the next lane
+			const counter_type high = ((x & ~lane_high_bits) + (lane_high_bits - lane_low_bits)) | x;
+			const counter_type flags = high & lane_high_bits;
+
+			lane_mask mask = 0;
+			for (size_type i = 0; i < Lanes; ++i){
+				mask |= static_cast<lane_mask>((flags >> (i*lane_bits + lane_bits - 1)) & 1) << i;
+			}
+			return mask;
+		}
+
+		void arrive_at(size_type id, lane_mask lanes){
+			if (!id){
+				nodes[0].X.fetch_add(increments(lanes), snzi_order::root_arrive);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes[id].X;
+			const counter_type inc = increments(lanes);
+			lane_mask propagated = 0; // lanes we have arrived at the parent for
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			do{
+				const lane_mask zero = lanes & ~nonzero_lanes(oldx) & ~propagated;
+				if (zero){
+					arrive_at(nodes[id].parent, zero);
+					propagated |= zero;
+				}
+			} while (!X.compare_exchange_weak(oldx, oldx + inc, snzi_order::arrive, snzi_order::cas_failure));
+
+			// the lanes that another thread took from 0 to 1 before our CAS already hold an arrival at the parent
+			const lane_mask extra = propagated & nonzero_lanes(oldx);
+			if (extra){
+				depart_at(nodes[id].parent, extra);
+			}
+		}
+
+		void depart_at(size_type id, lane_mask lanes){
+			if (!id){
+				nodes[0].X.fetch_sub(increments(lanes), snzi_order::root_depart);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes[id].X;
+			const counter_type dec = increments(lanes);
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			while (!X.compare_exchange_weak(oldx, oldx - dec, snzi_order::depart, snzi_order::cas_failure)){}
+
+			// the lanes that we took from 1 to 0
+			const lane_mask emptied = lanes & ~nonzero_lanes(oldx - dec);
+			if (emptied){
+				depart_at(nodes[id].parent, emptied);
+			}
+		}
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (as in snzi.hpp).
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		}
+	};
+
+	template<std::size_t Lanes> const std::size_t multi_lane_snzi<Lanes>::lane_count;
+	template<std::size_t Lanes> const std::size_t multi_lane_snzi<Lanes>::lane_bits;
+	template<std::size_t Lanes> const std::size_t multi_lane_snzi<Lanes>::max_lane_count;
+	template<std::size_t Lanes> const unsigned int multi_lane_snzi<Lanes>::all_lanes;
+	template<std::size_t Lanes> const std::uint64_t multi_lane_snzi<Lanes>::lane_low_bits;
+	template<std::size_t Lanes> const std::uint64_t multi_lane_snzi<Lanes>::lane_high_bits;
+
+} // namespace concurrent
+
+#endif /* MULTI_LANE_SNZI_HPP_ */
@@ -0,0 +1,187 @@
+#ifndef PARKING_HPP_
+#define PARKING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "backoff.hpp"
+#include "config.hpp"
+
+namespace concurrent{
+
+	namespace parking_detail{
+
+		inline long futex(const void* addr, int op, std::uint32_t val, const struct timespec* timeout){
+			return syscall(SYS_futex, addr, op, val, timeout, nullptr, 0);
+		}
+
+		/**
+		 * Returns the address of the 32 low-order bits of an atomic word, on which the futex operations are keyed. The x86 is little-endian,
+		 * so they are its first 4 bytes.
+		 */
+		template<typename T>
+		const void* futex_word(const std::atomic<T>& word){
+			static_assert(sizeof(std::atomic<T>) >= sizeof(std::uint32_t), "futex words must be at least 32 bits wide");
+			return &word;
+		}
+
+		/**
+		 * Counts the parked threads per address, hashed into a fixed number of slots. A thread that changes a word only issues the wake
+		 * system call if the slot of the word has waiters; two words that share a slot only cost each other a spurious system call.
+		 */
+		class parking_table{
+		public:
+			static const std::size_t Slots = 256;
+
+			struct slot{
+				alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> waiters;
+
+				slot(){
+					waiters.store(0);
+				}
+			};
+
+			static parking_table& instance(){
+				static parking_table table;
+				return table;
+			}
+
+			slot& slot_for(const void* addr){
+				std::uintptr_t a = reinterpret_cast<std::uintptr_t>(addr);
+				return slots[((a >> 6) ^ (a >> 14)) % Slots];
+			}
+
+		private:
+			slot slots[Slots];
+		};
+
+	} // namespace parking_detail
+
+	/**
+	 * A backoff policy for oversubscribed deployments (more threads than cores): it backs off as the Inner policy until it detects
+	 * oversubscription and then parks the thread in the kernel instead of yielding, so the waiting thread does not burn the CPU that the
+	 * thread it waits for needs.
+	 *
+	 * Oversubscription is detected when either of the following holds since the last reset():
+	 * 			+ more than SpinMicros microseconds were spent backing off, or
+	 * 			+ the thread was migrated to another CPU at least twice (as reported by sched_getcpu), a sign of scheduler churn.
+	 *
+	 * Once oversubscribed, a wait on a word (see backoff_traits) parks on a futex keyed to that word until a thread that changes the word calls
+	 * notify() for it, and a plain backoff() sleeps; in both cases for at most MaxParkMicros microseconds, doubling from 1 microsecond
+	 * in successive calls, so a missed wakeup only delays the waiter.
+	 *
+	 * The SNZI nodes wait on their counter for an announced Arrive operation and notify waiters when they take the counter from 0 to 1,
+	 * which is the change such a waiter expects. The CAS loop of the direct arrivals at the root has no change to wait for and sleeps.
+	 */
+	template<typename Inner = exponential_backoff, std::size_t SpinMicros = 50, std::size_t MaxParkMicros = 1000>
+	class parking_backoff{
+		static_assert(MaxParkMicros >= 1, "MaxParkMicros of parking_backoff must be >= 1");
+
+	public:
+		void backoff(){
+			if (!oversubscribed()){
+				inner.backoff();
+				return ;
+			}
+
+			std::this_thread::sleep_for(std::chrono::microseconds(next_park()));
+		}
+
+		/**
+		 * Waits for word to change from the value observed.
+		 */
+		template<typename T>
+		void wait(const std::atomic<T>& word, T observed){
+			if (!oversubscribed()){
+				inner.backoff();
+				return ;
+			}
+
+			const std::size_t micros = next_park();
+			struct timespec timeout;
+			timeout.tv_sec = micros/1000000;
+			timeout.tv_nsec = (micros%1000000)*1000;
+
+			parking_detail::parking_table::slot& s = parking_detail::parking_table::instance().slot_for(parking_detail::futex_word(word));
+			s.waiters.fetch_add(1);
+			// the kernel compares the word with the observed value after our registration, so a change that did not see us is seen by it
+			parking_detail::futex(parking_detail::futex_word(word), FUTEX_WAIT_PRIVATE, static_cast<std::uint32_t>(observed), &timeout);
+			s.waiters.fetch_sub(1);
+		}
+
+		/**
+		 * Wakes the threads parked on word. Called after word was changed.
+		 */
+		template<typename T>
+		static void notify(const std::atomic<T>& word){
+			parking_detail::parking_table::slot& s = parking_detail::parking_table::instance().slot_for(parking_detail::futex_word(word));
+			if (s.waiters.load()){
+				parking_detail::futex(parking_detail::futex_word(word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+			}
+		}
+
+		void reset(){
+			inner.reset();
+			started = false;
+			migrations = 0;
+			park_micros = 1;
+		}
+
+	private:
+		Inner inner;
+		bool started{false}; //! Whether start and cpu are valid
+		std::chrono::steady_clock::time_point start; //! When the backoff started
+		int cpu{-1}; //! The CPU the thread last ran on
+		int migrations{0}; //! CPU changes since the backoff started
+		std::size_t park_micros{1}; //! The next park duration
+
+		bool oversubscribed(){
+			if (!started){
+				started = true;
+				start = std::chrono::steady_clock::now();
+				cpu = sched_getcpu();
+				return false;
+			}
+
+			int c = sched_getcpu();
+			if (c != cpu){
+				cpu = c;
+				++migrations;
+			}
+
+			return migrations >= 2 || std::chrono::steady_clock::now() - start > std::chrono::microseconds(SpinMicros);
+		}
+
+		std::size_t next_park(){
+			std::size_t micros = park_micros;
+			if (park_micros < MaxParkMicros){
+				park_micros = park_micros*2 < MaxParkMicros ? park_micros*2 : MaxParkMicros;
+			}
+			return micros;
+		}
+	};
+
+	template<typename Inner, std::size_t SpinMicros, std::size_t MaxParkMicros>
+	struct backoff_traits<parking_backoff<Inner, SpinMicros, MaxParkMicros> >{
+		template<typename T>
+		static void wait(parking_backoff<Inner, SpinMicros, MaxParkMicros>& b, const std::atomic<T>& word, T observed){
+			b.wait(word, observed);
+		}
+
+		template<typename T>
+		static void notify(const std::atomic<T>& word){
+			parking_backoff<Inner, SpinMicros, MaxParkMicros>::notify(word);
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* PARKING_HPP_ */
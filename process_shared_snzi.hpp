@@ -0,0 +1,242 @@
+#ifndef PROCESS_SHARED_SNZI_HPP_
+#define PROCESS_SHARED_SNZI_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <new>
+#include <stdexcept>
+#include <atomic>
+#include "arrival_token.hpp"
+#include "config.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class process_shared_snzi implements the SNZI object of no_contention_handling_snzi in a region of memory provided by the caller, so
+	 * that several processes that map the region (with mmap(MAP_SHARED), possibly of a shm_open object) can Arrive, Depart and Query the same
+	 * indicator without an IPC round trip.
+	 *
+	 * The object is position independent: it stores no pointers, the nodes are linked by their indices and are found at a fixed offset
+	 * from the object, and the counters are lock-free atomics, which are address-free. The region may therefore be mapped at a different
+	 * address in each process.
+	 *
+	 * The region is laid out as the object itself, padded to a cache line, followed by the nodes in level order (index 0 is the root),
+	 * each on its own cache line. Its size is given by required_size(). One process constructs the object with create(), the others
+	 * obtain it with attach() once create() has returned (for example after a fork, or after a handshake of their own). The identifiers
+	 * in [0,T) are shared by all the threads of all the processes.
+	 *
+	 * Nothing needs to be destroyed: the region is released by unmapping it.
+	 */
+	class process_shared_snzi{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+
+	private:
+		using counter_type = std::uint64_t; //! Type used for the counter at each SNZI node
+
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "process_shared_snzi needs lock-free 64-bit atomics, which are address-free");
+
+		static const std::uint64_t magic_value = 0x534e5a4953484d31ull; //! Marks a constructed object ("SNZISHM1")
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			size_type parent; //! The index of the parent node
+
+			node(){
+				X.store(0, snzi_order::init);
+			}
+		};
+
+	public:
+
+		/**
+		 * \return The number of bytes of the region that holds a SNZI perfect K-ary tree of height H.
+		 * \throws std::invalid_argument If K is lower than 2.
+		 */
+		static size_type required_size(size_type K, size_type H){
+			return required_size(tree_shape::uniform(K,H));
+		}
+
+		/**
+		 * \return The number of bytes of the region that holds a SNZI tree with the given shape.
+		 */
+		static size_type required_size(const tree_shape& shape){
+			return header_size() + shape.nodes()*sizeof(node);
+		}
+
+		/**
+		 * Constructs a SNZI perfect K-ary tree of height H for T threads in the given region.
+		 *
+		 * \param region The region, aligned to CACHE_LINE_SIZE (as mappings are)
+		 * \param region_size The size of the region in bytes
+		 * \return The object, which is at the start of the region.
+		 * \throws std::invalid_argument If K is lower than 2, or the region is misaligned or smaller than required_size(K,H).
+		 */
+		static process_shared_snzi* create(void* region, size_type region_size, size_type K, size_type H, size_type T){
+			return create(region, region_size, tree_shape::uniform(K,H), T);
+		}
+
+		/**
+		 * Constructs a SNZI tree with the given shape for T threads in the given region.
+		 *
+		 * \throws std::invalid_argument If the region is misaligned or smaller than required_size(shape).
+		 */
+		static process_shared_snzi* create(void* region, size_type region_size, const tree_shape& shape, size_type T){
+			if (reinterpret_cast<std::uintptr_t>(region) % CACHE_LINE_SIZE){
+				throw std::invalid_argument("region of process_shared_snzi must be aligned to CACHE_LINE_SIZE");
+			}
+			if (region_size < required_size(shape)){
+				throw std::invalid_argument("region of process_shared_snzi is smaller than required_size()");
+			}
+
+			return new (region) process_shared_snzi(shape, T);
+		}
+
+		/**
+		 * Returns the object that another process has constructed in the given region with create().
+		 *
+		 * \throws std::invalid_argument If the region does not hold a constructed object.
+		 */
+		static process_shared_snzi* attach(void* region){
+			process_shared_snzi* snzi_object = static_cast<process_shared_snzi*>(region);
+			if (snzi_object->magic.load(std::memory_order_acquire) != magic_value){
+				throw std::invalid_argument("region passed to process_shared_snzi::attach does not hold a constructed object");
+			}
+			return snzi_object;
+		}
+
+		process_shared_snzi(const process_shared_snzi&) = delete;
+		process_shared_snzi& operator=(const process_shared_snzi&) = delete;
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid) or by any
+		 * thread of any process with Depart(token).
+		 *
+		 * \return The token that identifies the node at which the thread arrived.
+		 */
+		arrival_token Arrive(size_type tid){
+			const size_type leaf = get_leaf_for_thread(tid);
+			arrive_at(leaf);
+			return arrival_token(leaf);
+		}
+
+		/**
+		 * Called by a thread with identifier id, which should be in the range [0,T), after it has called Arrive() to declare
+		 * that is "departs".
+		 */
+		void Depart(size_type tid){
+			depart_at(get_leaf_for_thread(tid));
+		}
+
+		/**
+		 * Departs from the node at which the Arrive() operation that returned token arrived.
+		 */
+		void Depart(arrival_token token){
+			depart_at(token.node());
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in the SNZI tree.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool Query() const{
+			return nodes()[0].X.load(snzi_order::query) != 0;
+		}
+
+	private:
+		std::atomic<std::uint64_t> magic; //! magic_value once the object is constructed
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this SNZI object
+
+		process_shared_snzi(const tree_shape& shape, size_type T){
+			magic.store(0, std::memory_order_relaxed);
+
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
+			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			total_threads = T;
+
+			for (size_type i = 0; i < total_nodes; ++i){
+				node* n = new (nodes() + i) node;
+				n->parent = i ? shape.parent(i) : 0;
+			}
+
+			// publishes the construction to the processes that attach
+			magic.store(magic_value, std::memory_order_release);
+		}
+
+		static constexpr size_type header_size(){
+			return (sizeof(process_shared_snzi) + CACHE_LINE_SIZE - 1)/CACHE_LINE_SIZE*CACHE_LINE_SIZE;
+		}
+
+		node* nodes(){
+			return reinterpret_cast<node*>(reinterpret_cast<char*>(this) + header_size());
+		}
+
+		const node* nodes() const{
+			return reinterpret_cast<const node*>(reinterpret_cast<const char*>(this) + header_size());
+		}
+
+		void arrive_at(size_type id){
+			if (!id){
+				nodes()[0].X.fetch_add(1, snzi_order::root_arrive);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes()[id].X;
+			bool pArrInv = false;
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			do{
+				if (!oldx && !pArrInv){
+					arrive_at(nodes()[id].parent);
+					pArrInv = true;
+				}
+			} while (!X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure));
+
+			if (pArrInv && oldx){
+				depart_at(nodes()[id].parent);
+			}
+		}
+
+		void depart_at(size_type id){
+			if (!id){
+				nodes()[0].X.fetch_sub(1, snzi_order::root_depart);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes()[id].X;
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			while (!X.compare_exchange_weak(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure)){}
+
+			if (oldx == 1){
+				depart_at(nodes()[id].parent);
+			}
+		}
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (as in snzi.hpp).
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* PROCESS_SHARED_SNZI_HPP_ */
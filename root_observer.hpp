@@ -0,0 +1,31 @@
+#ifndef ROOT_OBSERVER_HPP_
+#define ROOT_OBSERVER_HPP_
+
+#include <cstddef>
+
+namespace concurrent{
+
+	/**
+	 * An observer of the root of a SNZI object: transition(context, index) is called after every change of the root counter from 0 to
+	 * nonzero and from nonzero to 0, by the thread that made it. The transitions of the root are rare by design, so the check costs the
+	 * operations on the root one comparison of the value that their fetch_add or CAS returns anyway.
+	 *
+	 * The call only says that the root went through a transition; by the time it runs the root may have gone back, and the calls of two
+	 * transitions may run in either order. An observer that mirrors the state of the root must therefore read it with Query() and
+	 * read it again after publishing it (see indicator_array.hpp).
+	 */
+	struct root_observer{
+		void (*transition)(void* context, std::size_t index){nullptr}; //! Called on each transition; nullptr for none
+		void* context{nullptr}; //! Passed to transition
+		std::size_t index{0}; //! Passed to transition, to tell the SNZI objects that share an observer apart
+
+		void notify() const{
+			if (transition){
+				transition(context, index);
+			}
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* ROOT_OBSERVER_HPP_ */
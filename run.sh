@@ -9,10 +9,64 @@ echo "Running no-contention..."
 echo ""
 ./snzi_no
 
+echo "Running no-contention with seq_cst orderings..."
+echo ""
+./snzi_no_seq_cst
+
 echo "Running semi-contention..."
 echo ""
 ./snzi_semi
 
+echo "Running semi-contention with seq_cst orderings..."
+echo ""
+./snzi_semi_seq_cst
+
+echo "Running semi-contention with departure hysteresis..."
+echo ""
+./snzi_semi_hysteresis
+
 echo "Running full-contention..."
 echo ""
 ./snzi_full
+
+echo "Running full-contention with seq_cst orderings..."
+echo ""
+./snzi_full_seq_cst
+
+echo "Running full-contention with fetch_add nodes..."
+echo ""
+./snzi_full_fetch_add
+
+echo "Running full-contention with a combining root..."
+echo ""
+./snzi_full_combining
+
+echo "Running padding..."
+echo ""
+make -f makefile-padding clean
+make -f makefile-padding
+./snzi_padding
+
+echo "Running backoff..."
+echo ""
+make -f makefile-backoff clean
+make -f makefile-backoff
+./snzi_backoff
+
+echo "Running process-shared..."
+echo ""
+make -f makefile-process-shared clean
+make -f makefile-process-shared
+./snzi_process_shared
+
+echo "Running tail latency..."
+echo ""
+make -f makefile-tail-latency clean
+make -f makefile-tail-latency
+./snzi_tail_latency
+
+echo "Running combining counter..."
+echo ""
+make -f makefile-combining-counter clean
+make -f makefile-combining-counter
+./snzi_combining_counter
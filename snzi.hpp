@@ -7,9 +7,17 @@
 #include <cmath>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 #include <atomic>
+#include "arrival_token.hpp"
 #include "backoff.hpp"
 #include "config.hpp"
+#include "departure_hysteresis.hpp"
+#include "root_observer.hpp"
+#include "snzi_arena.hpp"
+#include "snzi_layout.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
 
 namespace concurrent{
 
@@ -28,7 +36,9 @@ namespace concurrent{
 	 *
 	 * Implementation details useful for clients.
 	 *
-	 * A SNZI object is implemented as a perfect K-ary tree of height H. The threads start their Arrive and Depart operations on a leaf node
+	 * A SNZI object is implemented as a perfect K-ary tree of height H, or more generally as a tree whose levels have different fan-outs (see tree_shape).
+	 * The latter allows each level of the tree to map exactly to a cache-sharing domain (for example {2,8,2} for 2 sockets of 8 cores with 2 hardware threads each).
+	 * The threads start their Arrive and Depart operations on a leaf node
 	 * (the Query operation is always serviced from the root of the tree). It is generally beneficial to have more than 1 thread use the same leaf node because otherwise if only 1 thread uses a leaf node then it will always call operations on the
 	 * parent node and thus increasing contention on it. For this reason, the height H should be chosen such that the number of leaf nodes L is lower
 	 * that the number of threads T to use the SNZI object. Also, the threads with identifiers {0,1,2,...,N-1} are assigned to the leaf in linear order;
@@ -38,6 +48,9 @@ namespace concurrent{
 	 * 			+ leaf 2: threads 4 and 5
 	 * 			+ leaf 3: threads 6 and 7
 	 * The above doesn't apply if the number of nodes is less than the number of leaf nodes.
+	 *
+	 * Arrive is an acquire operation and Depart a release operation; see snzi_ordering.hpp for the full ordering contract, including the
+	 * fence that Dekker-style clients need.
 	 */
 
 
@@ -52,21 +65,37 @@ namespace concurrent{
 		struct root_node{
 			// to avoid false sharing with other snzi nodes
 			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			root_observer observer; //! Notified of the transitions between 0 and nonzero
 
 			root_node(){
-				X.store(0);
+				X.store(0, snzi_order::init);
+			}
+
+			// moves the value of the counter, for the move operations of the tree (which require a quiescent tree)
+			root_node(root_node&& other) : observer(other.observer){
+				X.store(other.X.load(snzi_order::probe), snzi_order::init);
+			}
+
+			root_node& operator=(root_node&& other){
+				X.store(other.X.load(snzi_order::probe), snzi_order::init);
+				observer = other.observer;
+				return *this;
 			}
 
 			void Arrive(){
-				X.fetch_add(1);
+				if (!X.fetch_add(1, snzi_order::root_arrive)){
+					observer.notify();
+				}
 			}
 
 			void Depart(){
-				X.fetch_sub(1);
+				if (X.fetch_sub(1, snzi_order::root_depart) == 1){
+					observer.notify();
+				}
 			}
 
 			bool Query() const{
-				return X.load() != 0;
+				return X.load(snzi_order::query) != 0;
 			}
 		};
 
@@ -74,55 +103,58 @@ namespace concurrent{
 			// to avoid false sharing with other snzi nodes
 			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
 			size_type parent;
-			no_contention_handling_snzi* snzi_tree;
 
 			node(){
-				X.store(0);
+				X.store(0, snzi_order::init);
 			}
 
-			void Arrive(){
+			bool Query() const{
+				return X.load(snzi_order::query) != 0;
+			}
+
+			void Arrive(no_contention_handling_snzi& snzi_tree){
 				bool pArrInv = false;
 
-				counter_type oldx = X.load();
+				counter_type oldx = X.load(snzi_order::probe);
 
 				do{
 					if (!oldx && !pArrInv){
 						switch(parent){
 						case 0:
-							snzi_tree->root.Arrive();
+							snzi_tree.root.Arrive();
 							break;
 						default:
-							snzi_tree->others[parent].Arrive();
+							snzi_tree.others[parent].Arrive(snzi_tree);
 							break;
 						}
 						pArrInv = true;
 					}
-				} while (!X.compare_exchange_weak(oldx, oldx + 1));
+				} while (!X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure));
 
 				if (pArrInv && oldx){
 					switch(parent){
 					case 0:
-						snzi_tree->root.Depart();
+						snzi_tree.root.Depart();
 						break;
 					default:
-						snzi_tree->others[parent].Depart();
+						snzi_tree.others[parent].Depart(snzi_tree);
 						break;
 					}
 				}
 			}
 
-			void Depart(){
-				counter_type oldx = X.load();
+			void Depart(no_contention_handling_snzi& snzi_tree){
+				counter_type oldx = X.load(snzi_order::probe);
 
-				while (!X.compare_exchange_weak(oldx, oldx - 1)){}
+				while (!X.compare_exchange_weak(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure)){}
 
 				if (oldx == 1){
 					switch(parent){
 					case 0:
-						snzi_tree->root.Depart();
+						snzi_tree.root.Depart();
 						break;
 					default:
-						snzi_tree->others[parent].Depart();
+						snzi_tree.others[parent].Depart(snzi_tree);
 						break;
 					}
 				}
@@ -147,22 +179,36 @@ namespace concurrent{
 		 * \param K The arity of the SNZI tree
 		 * \param H The height of the SNZI tree
 		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
 		 * \throws std::invalid_argument If at least one of the restrictions is not satisfied.
 		 */
-		no_contention_handling_snzi(size_type K, size_type H, size_type T){
-			if (K < 2){
-				throw std::invalid_argument("K parameter in snzi constructor must be >= 2");
-			}
+		no_contention_handling_snzi(size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : no_contention_handling_snzi(tree_shape::uniform(K,H), T, arena){}
+
+		/**
+		 * Constructs a SNZI tree whose levels have the given fan-outs, listed from the root downwards (see tree_shape).
+		 * T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * \param fanout The number of children of the nodes at each level; its size is the height of the tree
+		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
+		 * \throws std::invalid_argument If any fan-out is lower than 2.
+		 */
+		no_contention_handling_snzi(const std::vector<size_type>& fanout, size_type T, snzi_arena* arena = nullptr) : no_contention_handling_snzi(tree_shape(fanout), T, arena){}
 
-			// the total number of nodes in the K-ary tree of height H.
-			total_nodes = nodes_count(K,H);
-			total_leaf_nodes = leaves_count(K,H);
+		/**
+		 * Constructs a SNZI tree with the given shape. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * The nodes are allocated from arena (see snzi_arena.hpp), which must outlive the SNZI object, or from the heap if arena is nullptr.
+		 */
+		no_contention_handling_snzi(const tree_shape& shape, size_type T, snzi_arena* arena = nullptr) : shape(shape){
+			// the total number of nodes in the tree.
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
 			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
 			if (!threads_per_leaf){
 				threads_per_leaf = 1;
 			}
 			total_threads = T;
-			arity = K;
 
 			/**
 			 * We place the root node in its own (in the local variable root because it is special). That means
@@ -171,22 +217,31 @@ namespace concurrent{
 			 * others array and, thus, instead of n-1 nodes we allocate n nodes in the others array.
 			 * This also allow us to index the leaf nodes in the others array with their normal indices.
 			 */
-			others.reset(new node[total_nodes]);
+			others = make_node_array<node>(arena, total_nodes);
 
-			// We must set the snzi pointer in the other nodes so that they can navigate in the tree (to find their parents)
-			// and tell them which is their id
+			// We must tell the other nodes which is their parent so that they can navigate in the tree
 			for (size_type i = 1; i < total_nodes; ++i){
-				others[i].snzi_tree = this;
-				others[i].parent = parent(i);
+				others[i].parent = shape.parent(i);
 			}
 		}
 
+		/**
+		 * Moves a SNZI object. The nodes find each other through their indices and the tree that they are called on, so the moved object
+		 * works at its new address and the objects can be kept by value, e.g. in a std::vector. Only a quiescent object (no operation in
+		 * progress and none until the move completes) may be moved; the moved-from object may only be destroyed or assigned to.
+		 */
+		no_contention_handling_snzi(no_contention_handling_snzi&&) = default;
+		no_contention_handling_snzi& operator=(no_contention_handling_snzi&&) = default;
+
 		/**
 		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
 		 *
-		 * An Arrive() operation by a thread should be matched by a Depart() operation.
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid) or by any
+		 * thread with Depart(token), where token is the value returned by Arrive().
+		 *
+		 * \return The token that identifies the node at which the thread arrived.
 		 */
-		void Arrive(size_type tid){
+		arrival_token Arrive(size_type tid){
 			size_type leaf = get_leaf_for_thread(tid);
 
 			switch(leaf){
@@ -194,9 +249,11 @@ namespace concurrent{
 				root.Arrive();
 				break;
 			default:
-				others[leaf].Arrive();
+				others[leaf].Arrive(*this);
 				break;
 			}
+
+			return arrival_token(leaf);
 		}
 
 		/**
@@ -211,7 +268,21 @@ namespace concurrent{
 				root.Depart();
 				break;
 			default:
-				others[leaf].Depart();
+				others[leaf].Depart(*this);
+				break;
+			}
+		}
+
+		/**
+		 * Departs from the node at which the Arrive() operation that returned token arrived. It may be called by any thread, once per token.
+		 */
+		void Depart(arrival_token token){
+			switch(token.node()){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				others[token.node()].Depart(*this);
 				break;
 			}
 		}
@@ -225,14 +296,67 @@ namespace concurrent{
 			return root.Query();
 		}
 
+		/**
+		 * Tests whether there is an "active" thread among the threads assigned to the leaves of the subtree rooted at the node with index id
+		 * (the nodes are numbered in level order, see tree_shape). The answer is read from the counter of that node, which is what its parent
+		 * sees, so it is as cheap as Query() and does not disturb the other subtrees. QuerySubtree(0) is Query().
+		 *
+		 * \param id The index of the node, in the range [0,number of nodes)
+		 * \return True if there is a surplus of Arrive operations from Depart operations in the subtree.
+		 */
+		bool QuerySubtree(size_type id) const{
+			assert(id < total_nodes);
+
+			if (!id){
+				return root.Query();
+			}
+			return others[id].Query();
+		}
+
+		/**
+		 * Tests whether there is an "active" thread in the cache-sharing domain that maps to the node at position index of level depth. For
+		 * example, on a tree with the fan-outs {sockets, cores per socket, threads per core} QueryDomain(1, s) tells whether a thread of
+		 * socket s is present.
+		 *
+		 * \param depth The level of the domain, at most the height of the tree
+		 * \param index The position of the domain in its level, lower than the number of nodes of the level
+		 * \return QuerySubtree() of the node at position index of level depth.
+		 */
+		bool QueryDomain(size_type depth, size_type index) const{
+			return QuerySubtree(shape.node_at(depth, index));
+		}
+
+		/**
+		 * Returns a quiescent SNZI object (no thread has arrived and no operation is in progress) to the state in which the constructor
+		 * leaves it, without allocating: the counters and flags of the nodes are cleared and the root observer is removed. This is
+		 * much cheaper than constructing a new object, so short-lived indicators can be reused (see snzi_pool.hpp).
+		 *
+		 * Like the constructor, it doesn't guarantee memory visibility of the new state. This should be established by other means.
+		 */
+		void reset(){
+			for (size_type i = 1; i < total_nodes; ++i){
+				others[i].X.store(0, snzi_order::init);
+			}
+			root.X.store(0, snzi_order::init);
+			root.observer = root_observer();
+		}
+
+		/**
+		 * Sets the observer that is notified of the transitions of the root between 0 and nonzero (see root_observer.hpp). It should be
+		 * set before the SNZI object is used.
+		 */
+		void set_root_observer(const root_observer& observer){
+			root.observer = observer;
+		}
+
 	private:
-		size_type arity; //! The arity of the SNZI tree
+		tree_shape shape; //! The shape of the SNZI tree
 		size_type total_nodes; //! Total number on nodes in the SNZI tree
 		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
 		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
 		size_type total_threads; //! Number of threads to use this SNZI object
 		root_node root; //! The root SNZI object of the tree
-		std::unique_ptr<node[]> others{nullptr}; //! The other SNZI objects of the tree
+		node_array<node> others{nullptr}; //! The other SNZI objects of the tree
 
 		/**
 		 * Returns the index of the leaf node in the others array where the thread with the given id is assigned (for Arrive and Depart operations).
@@ -250,45 +374,25 @@ namespace concurrent{
 			 */
 			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
 		}
-
-		/**
-		 * Returns the index of the parent of the node with index id.
-		 *
-		 * \param id The index of the node
-		 * \return The index of id's parent
-		 */
-		size_type parent(size_type id) const{
-			return (id - 1)/arity;
-		}
-
-		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
-		 */
-		static size_type nodes_count(size_type K, size_type H){
-			assert(K != 1);
-			return (pow_int(K,H+1) - 1)/(K-1);
-		}
-
-		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
-		 */
-		static size_type leaves_count(size_type K, size_type H){
-			return pow_int(K,H);
-		}
-
-		/**
-		 * \return b raised to the power of e.
-		 */
-		static size_type pow_int(size_type b, size_type e){
-			size_type result = 1;
-			for (size_type i = 1; i <= e; ++i){
-				result *= b;
-			}
-			return result;
-		}
 	};
 
-	class semi_contention_handling_snzi{
+	/**
+	 * The layout of the nodes is chosen by two layout policies (see snzi_layout.hpp): LeafLayout for the leaves and InteriorLayout for the
+	 * nodes between the root and the leaves. The default, split_layout, places X and announce on separate cache lines. compact_layout keeps
+	 * the announce flag in the high bit of X so that the announce check and the counter CAS touch a single line, and packed_layout additionally
+	 * drops the padding so that several nodes share a line; the latter is meant for the interior levels, which see few operations by design,
+	 * when thousands of indicators are used and their footprint matters more than the false sharing between interior nodes. fetch_add_layout
+	 * replaces the CAS loops with a single fetch_add or fetch_sub, so operations on a busy leaf that find it nonzero never retry.
+	 *
+	 * Backoff is the backoff policy (see backoff.hpp) used while waiting for an announced Arrive operation to complete. The number of
+	 * backoff rounds of that wait is set with set_announce_delay().
+	 *
+	 * The announce flag saves the parent traffic of Arrive operations that find a node 0 together. A node that goes back and forth
+	 * between 0 and 1 still departs from its parent and arrives at it again each time, and the lines up to the root bounce for nothing.
+	 * set_departure_hysteresis() lets the nodes hold on to their arrivals at their parents for a bounded time (see departure_hysteresis.hpp).
+	 */
+	template<typename LeafLayout = split_layout, typename InteriorLayout = LeafLayout, typename Backoff = exponential_backoff>
+	class basic_semi_contention_handling_snzi{
 	public:
 		using size_type = std::size_t; //! For sizes and thread identifiers
 
@@ -298,108 +402,167 @@ namespace concurrent{
 		struct root_node{
 			// to avoid false sharing with other snzi nodes
 			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			root_observer observer; //! Notified of the transitions between 0 and nonzero
+			// read by the queriers while the root is nonzero, so kept off the line of X
+			alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> next_sweep; //! When a query may next release stale held arrivals (TSC)
 
 			root_node(){
-				X.store(0);
+				X.store(0, snzi_order::init);
+				next_sweep.store(0, snzi_order::init);
+			}
+
+			// moves the value of the counter, for the move operations of the tree (which require a quiescent tree)
+			root_node(root_node&& other) : root_node(){
+				move_from(other);
+			}
+
+			root_node& operator=(root_node&& other){
+				move_from(other);
+				return *this;
+			}
+
+			void move_from(root_node& other){
+				X.store(other.X.load(snzi_order::probe), snzi_order::init);
+				observer = other.observer;
+				next_sweep.store(0, snzi_order::init);
 			}
 
 			void Arrive(){
-				X.fetch_add(1);
+				if (!X.fetch_add(1, snzi_order::root_arrive)){
+					observer.notify();
+				}
 			}
 
 			void Depart(){
-				X.fetch_sub(1);
+				if (X.fetch_sub(1, snzi_order::root_depart) == 1){
+					observer.notify();
+				}
 			}
 
 			bool Query() const{
-				return X.load() != 0;
+				return X.load(snzi_order::query) != 0;
 			}
 		};
 
+		/**
+		 * A SNZI node whose counter and announce flag are stored according to Layout (see snzi_layout.hpp).
+		 * The update_path of the cell selects between the CAS loops and the fetch_add path of fetch_add_layout.
+		 */
+		template<typename Layout>
 		struct node{
-			// to avoid false sharing with other snzi nodes
-			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
-			alignas(CACHE_LINE_SIZE) std::atomic<bool> announce;
+			using cell_type = typename Layout::template cell<counter_type>;
+
+			cell_type state;
 			size_type parent;
-			semi_contention_handling_snzi* snzi_tree;
 
-			node(){
-				X.store(0);
-				announce.store(false);
+			void Arrive(basic_semi_contention_handling_snzi& snzi_tree, size_type id){
+				arrive(snzi_tree, id, typename cell_type::update_path{});
 			}
 
-			void Arrive(){
+			bool Query() const{
+				return state.count(state.word().load(snzi_order::query)) != 0;
+			}
+
+			// the Depart operations only change the nodes and the root, so that a query can release the stale held arrivals
+			void Depart(const basic_semi_contention_handling_snzi& snzi_tree, size_type id){
+				depart(snzi_tree, id, typename cell_type::update_path{});
+			}
+
+			void arrive(basic_semi_contention_handling_snzi& snzi_tree, size_type id, cas_update){
 				bool pArrInv = false;
 
-				counter_type oldx = X.load();
+				counter_type oldx = state.load();
 
 				do{
-					if (!oldx && !pArrInv){
+					if (!state.count(oldx) && !pArrInv){
 						bool doArrive = true;
-						if (announce.load()){
-							exponential_backoff backoff;
-							const int DelayAmount = 16;
-							for (int i = 0; i < DelayAmount; ++i){
-								oldx = X.load();
-								if (oldx){ doArrive = false; break; }
-								backoff.backoff();
+						if (state.announced(oldx)){
+							Backoff backoff;
+							for (std::size_t i = 0; i < snzi_tree.announce_delay; ++i){
+								oldx = state.load();
+								if (state.count(oldx)){ doArrive = false; break; }
+								backoff_traits<Backoff>::wait(backoff, state.word(), oldx);
 							}
 						}
 						if (doArrive){
-							announce.store(true);
-							switch(parent){
-							case 0:
-								snzi_tree->root.Arrive();
-								break;
-							default:
-								snzi_tree->others[parent].Arrive();
-								break;
-							}
+							state.set_announce(oldx);
+							snzi_tree.arrive_from(id, parent);
 							pArrInv = true;
 						}
 					}
-				} while (!X.compare_exchange_weak(oldx, oldx + 1));
+				} while (!state.increment(oldx));
 
-				if (pArrInv && oldx){
-					switch(parent){
-					case 0:
-						snzi_tree->root.Depart();
-						break;
-					default:
-						snzi_tree->others[parent].Depart();
-						break;
-					}
+				if (!state.count(oldx)){
+					// wake the threads that wait for the announced Arrive operation to complete
+					backoff_traits<Backoff>::notify(state.word());
+				}
+
+				if (pArrInv && state.count(oldx)){
+					snzi_tree.depart_at_parent(parent);
 				}
 			}
 
-			void Depart(){
-				counter_type oldx = X.load();
+			void depart(const basic_semi_contention_handling_snzi& snzi_tree, size_type id, cas_update){
+				counter_type oldx = state.load();
 
-				do{
-					if (oldx == 1){
-						announce.store(false);
+				while (!state.decrement(oldx)){}
+
+				if (state.count(oldx) == 1){
+					snzi_tree.depart_from(id, parent);
+				}
+			}
+
+			void arrive(basic_semi_contention_handling_snzi& snzi_tree, size_type id, fetch_add_update){
+				counter_type oldx = state.fetch_increment();
+
+				if (state.settled(oldx)){
+					// the parent holds the arrival of this node and cannot lose it while we are counted
+					return ;
+				}
+
+				if (state.count(oldx)){
+					// the thread that took the counter from 0 propagates the arrival; wait for it as for an announced Arrive operation
+					oldx = state.observe();
+					Backoff backoff;
+					for (std::size_t i = 0; i < snzi_tree.announce_delay && !state.settled(oldx); ++i){
+						backoff_traits<Backoff>::wait(backoff, state.word(), oldx);
+						oldx = state.observe();
 					}
-					// use a strong version here to avoid the possibility of a spurious failure while oldx == 1
-					// that would lead to two stores to announce
-				} while (!X.compare_exchange_strong(oldx, oldx - 1));
+				}
 
-				if (oldx == 1){
-					switch(parent){
-					case 0:
-						snzi_tree->root.Depart();
-						break;
-					default:
-						snzi_tree->others[parent].Depart();
-						break;
+				if (state.settled(oldx)){
+					return ;
+				}
+
+				snzi_tree.arrive_from(id, parent);
+
+				while (!state.settled(oldx)){
+					if (state.settle(oldx)){
+						// wake the threads that wait for the arrival to be propagated
+						backoff_traits<Backoff>::notify(state.word());
+						return ;
 					}
 				}
+
+				// another thread published its arrival at the parent first
+				snzi_tree.depart_at_parent(parent);
+			}
+
+			void depart(const basic_semi_contention_handling_snzi& snzi_tree, size_type id, fetch_add_update){
+				counter_type oldx = state.fetch_decrement();
+
+				if (state.count(oldx) == 1 && state.unsettle()){
+					snzi_tree.depart_from(id, parent);
+				}
 			}
 		};
 
+		using interior_node = node<InteriorLayout>; //! Nodes that are neither the root nor leaves
+		using leaf_node = node<LeafLayout>; //! Nodes where the threads call their operations
+
 	public:
 
 		friend class root_node;
-		friend class node;
 
 		/**
 		 * Constructs a SNZI perfect K-ary tree with height H. T specifies the maximum number of threads that will use the SNZI object.
@@ -414,46 +577,75 @@ namespace concurrent{
 		 * \param K The arity of the SNZI tree
 		 * \param H The height of the SNZI tree
 		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
 		 * \throws std::invalid_argument If at least one of the restrictions is not satisfied.
 		 */
-		semi_contention_handling_snzi(size_type K, size_type H, size_type T){
-			if (K < 2){
-				throw std::invalid_argument("K parameter in snzi constructor must be >= 2");
-			}
+		basic_semi_contention_handling_snzi(size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : basic_semi_contention_handling_snzi(tree_shape::uniform(K,H), T, arena){}
 
-			// the total number of nodes in the K-ary tree of height H.
-			total_nodes = nodes_count(K,H);
-			total_leaf_nodes = leaves_count(K,H);
+		/**
+		 * Constructs a SNZI tree whose levels have the given fan-outs, listed from the root downwards (see tree_shape).
+		 * T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * \param fanout The number of children of the nodes at each level; its size is the height of the tree
+		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
+		 * \throws std::invalid_argument If any fan-out is lower than 2.
+		 */
+		basic_semi_contention_handling_snzi(const std::vector<size_type>& fanout, size_type T, snzi_arena* arena = nullptr) : basic_semi_contention_handling_snzi(tree_shape(fanout), T, arena){}
+
+		/**
+		 * Constructs a SNZI tree with the given shape. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * The nodes are allocated from arena (see snzi_arena.hpp), which must outlive the SNZI object, or from the heap if arena is nullptr.
+		 */
+		basic_semi_contention_handling_snzi(const tree_shape& shape, size_type T, snzi_arena* arena = nullptr) : shape(shape){
+			// the total number of nodes in the tree.
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
 			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
 			if (!threads_per_leaf){
 				threads_per_leaf = 1;
 			}
 			total_threads = T;
-			arity = K;
 
 			/**
 			 * We place the root node in its own (in the local variable root because it is special). That means
-			 * we are left with n-1 other nodes to allocate in local variable others.
+			 * we are left with n-1 other nodes of which the l leaves are allocated in local variable leaves and the rest in local variable interior.
 			 * But, because the children of the root node which has index 0 are 1,2,... we do not use the 0 index of the
-			 * others array and, thus, instead of n-1 nodes we allocate n nodes in the others array.
-			 * This also allow us to index the leaf nodes in the others array with their normal indices.
+			 * interior array and, thus, instead of n-l-1 nodes we allocate n-l nodes in the interior array.
+			 * This also allow us to index the interior nodes in the interior array with their normal indices. The leaves, which
+			 * may use a different layout, are kept in the leaves array starting from index 0.
 			 */
-			others.reset(new node[total_nodes]);
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			interior = make_node_array<interior_node>(arena, first_leaf);
+			leaves = make_node_array<leaf_node>(arena, total_leaf_nodes);
 
-			// We must set the snzi pointer in the other nodes so that they can navigate in the tree (to find their parents)
-			// and tell them which is their id
-			for (size_type i = 1; i < total_nodes; ++i){
-				others[i].snzi_tree = this;
-				others[i].parent = parent(i);
+			// We must tell the other nodes which is their parent so that they can navigate in the tree
+			for (size_type i = 1; i < first_leaf; ++i){
+				interior[i].parent = shape.parent(i);
+			}
+			for (size_type i = first_leaf ? first_leaf : 1; i < total_nodes; ++i){
+				leaves[i - first_leaf].parent = shape.parent(i);
 			}
 		}
 
+		/**
+		 * Moves a SNZI object. The nodes find each other through their indices and the tree that they are called on, so the moved object
+		 * works at its new address and the objects can be kept by value, e.g. in a std::vector. Only a quiescent object (no operation in
+		 * progress and none until the move completes) may be moved; the moved-from object may only be destroyed or assigned to.
+		 */
+		basic_semi_contention_handling_snzi(basic_semi_contention_handling_snzi&&) = default;
+		basic_semi_contention_handling_snzi& operator=(basic_semi_contention_handling_snzi&&) = default;
+
 		/**
 		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
 		 *
-		 * An Arrive() operation by a thread should be matched by a Depart() operation.
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid) or by any
+		 * thread with Depart(token), where token is the value returned by Arrive().
+		 *
+		 * \return The token that identifies the node at which the thread arrived.
 		 */
-		void Arrive(size_type tid){
+		arrival_token Arrive(size_type tid){
 			size_type leaf = get_leaf_for_thread(tid);
 
 			switch(leaf){
@@ -461,9 +653,11 @@ namespace concurrent{
 				root.Arrive();
 				break;
 			default:
-				others[leaf].Arrive();
+				leaves[leaf - (total_nodes - total_leaf_nodes)].Arrive(*this, leaf);
 				break;
 			}
+
+			return arrival_token(leaf);
 		}
 
 		/**
@@ -478,7 +672,21 @@ namespace concurrent{
 				root.Depart();
 				break;
 			default:
-				others[leaf].Depart();
+				leaves[leaf - (total_nodes - total_leaf_nodes)].Depart(*this, leaf);
+				break;
+			}
+		}
+
+		/**
+		 * Departs from the node at which the Arrive() operation that returned token arrived. It may be called by any thread, once per token.
+		 */
+		void Depart(arrival_token token){
+			switch(token.node()){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				leaves[token.node() - (total_nodes - total_leaf_nodes)].Depart(*this, token.node());
 				break;
 			}
 		}
@@ -486,76 +694,289 @@ namespace concurrent{
 		/**
 		 * Tests whether there is an "active" thread that has arrived in the SNZI tree.
 		 *
+		 * With the hysteresis of set_departure_hysteresis(), a query that finds the root nonzero also releases the held arrivals that are
+		 * past the staleness bound, if neither a query nor a Depart operation did so during the last staleness bound, so the surplus of the
+		 * held arrivals is gone within twice the bound after the last Depart operation. While Depart operations hold arrivals they take
+		 * these turns and the queries only read the root, but a query on a tree that went quiet may take one: it then reads the held arrival
+		 * of every node (a cache line each), departs from the parents of the stale ones up to the root, and may run the root observer (see
+		 * set_root_observer()) when the root goes to 0.
+		 *
 		 * \return True is there is a surplus of Arrive operations from Depart operations.
 		 */
 		bool Query() const{
+			if (!root.Query()){
+				return false;
+			}
+			return !expire_held() || root.Query();
+		}
+
+		/**
+		 * Tests whether there is an "active" thread among the threads assigned to the leaves of the subtree rooted at the node with index id
+		 * (the nodes are numbered in level order, see tree_shape). The answer is read from the counter of that node, which is what its parent
+		 * sees, so it is as cheap as Query() and does not disturb the other subtrees. QuerySubtree(0) is Query(). Like Query(), it releases
+		 * the stale held arrivals when it finds the node nonzero.
+		 *
+		 * \param id The index of the node, in the range [0,number of nodes)
+		 * \return True if there is a surplus of Arrive operations from Depart operations in the subtree.
+		 */
+		bool QuerySubtree(size_type id) const{
+			assert(id < total_nodes);
+
+			if (!id){
+				return Query();
+			}
+			if (!query_node(id)){
+				return false;
+			}
+			return !expire_held() || query_node(id);
+		}
+
+		/**
+		 * Tests whether there is an "active" thread in the cache-sharing domain that maps to the node at position index of level depth. For
+		 * example, on a tree with the fan-outs {sockets, cores per socket, threads per core} QueryDomain(1, s) tells whether a thread of
+		 * socket s is present.
+		 *
+		 * \param depth The level of the domain, at most the height of the tree
+		 * \param index The position of the domain in its level, lower than the number of nodes of the level
+		 * \return QuerySubtree() of the node at position index of level depth.
+		 */
+		bool QueryDomain(size_type depth, size_type index) const{
+			return QuerySubtree(shape.node_at(depth, index));
+		}
+
+		/**
+		 * Releases every arrival that a node holds at its parent (see set_departure_hysteresis()), whatever its age, and then queries the
+		 * SNZI object. An arrival that is held after the release was active during the call, so a caller that stops new arrivals first (as a
+		 * writer does) and retries while the answer is true gets an exact answer without waiting for the staleness bound.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool QueryAccurate(){
+			release_held(0, 0, true);
 			return root.Query();
 		}
 
-	private:
-		size_type arity; //! The arity of the SNZI tree
-		size_type total_nodes; //! Total number on nodes in the SNZI tree
-		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
-		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
-		size_type total_threads; //! Number of threads to use this SNZI object
-		root_node root; //! The root SNZI object of the tree
-		std::unique_ptr<node[]> others{nullptr}; //! The other SNZI objects of the tree
+		/**
+		 * Returns a quiescent SNZI object (no thread has arrived and no operation is in progress) to the state in which the constructor
+		 * leaves it, without allocating: the counters and flags of the nodes are cleared, the announce delay is set back to its default and
+		 * the root observer is removed. The held arrivals are forgotten and the setting of set_departure_hysteresis() is kept. This is much
+		 * cheaper than constructing a new object, so short-lived indicators can be reused (see snzi_pool.hpp).
+		 *
+		 * Like the constructor, it doesn't guarantee memory visibility of the new state. This should be established by other means.
+		 */
+		void reset(){
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			for (size_type i = 1; i < first_leaf; ++i){
+				interior[i].state.reset();
+			}
+			for (size_type i = 0; i < total_leaf_nodes; ++i){
+				leaves[i].state.reset();
+			}
+			if (holds){
+				for (size_type i = 1; i < total_nodes; ++i){
+					holds[i].reset();
+				}
+			}
+			announce_delay = default_announce_delay;
+			root.X.store(0, snzi_order::init);
+			root.next_sweep.store(0, snzi_order::init);
+			root.observer = root_observer();
+		}
 
 		/**
-		 * Returns the index of the leaf node in the others array where the thread with the given id is assigned (for Arrive and Depart operations).
+		 * Sets the hysteresis of the departures (see departure_hysteresis.hpp; off by default). With it, a node whose counter goes to 0 holds
+		 * on to its arrival at the parent, and the next Arrive operation that finds the node 0 takes it back instead of arriving at the
+		 * parent again, so a node that goes back and forth between 0 and 1 leaves its ancestors alone.
 		 *
-		 * \param tid The id of the thread calling the Arrive or Depart operations.
-		 * \return The index of the leaf where that thread should call its Arrive and Depart operations.
+		 * The held arrivals are still counted by the parents. The Depart operations and the queries release the ones that are older than
+		 * policy.staleness_ns, at most once per that time (see Query()), so Query() reports a surplus made only of held arrivals for at most
+		 * twice that long after the last Depart operation; QueryAccurate() releases them all at once. A query that finds the root 0 costs no
+		 * more than without hysteresis, but once per policy.staleness_ns a query on a quiet tree scans the held arrivals of all the nodes and
+		 * departs up to the root, running the root observer if the root goes to 0. The held arrivals take a cache line per node. Like the
+		 * constructor, this function doesn't guarantee memory visibility; it should be called before the SNZI object is shared, and turning
+		 * the hysteresis off requires a quiescent object, whose held arrivals are released first.
 		 */
-		size_type get_leaf_for_thread(size_type tid) const{
-			/**
-			 * Thread with this id will use the id/r-th leaf node.
-			 * If we have n total nodes and l leaf nodes then the leaf nodes start at index
-			 * l_offset=n-l in the others array, and thus the thread with this id will be assigned
-			 * to leaf node l_offset + i/r in the other array. To avoid cases where i/r exceeds the possible range
-			 * of leaf nodes we use i/r mod l.
-			 */
-			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		void set_departure_hysteresis(const departure_hysteresis& policy){
+			release_held(0, 0, true);
+			hysteresis = policy;
+			staleness_ticks = static_cast<std::uint64_t>((double)policy.staleness_ns*backoff_detail::tsc_ticks_per_ns());
+			holds.reset(policy.enabled() ? new held_arrival[total_nodes] : nullptr);
+			root.next_sweep.store(0, snzi_order::init);
 		}
 
 		/**
-		 * Returns the index of the parent of the node with index id.
+		 * Releases the arrivals that nodes have held at their parents for longer than the staleness bound of set_departure_hysteresis(),
+		 * as the queries do, but without waiting for the next turn of the queries. The nodes are visited from the leaves up, and an arrival
+		 * that a parent holds because of a release is released as well, so a surplus made only of stale held arrivals is gone from the root
+		 * when the call returns.
 		 *
-		 * \param id The index of the node
-		 * \return The index of id's parent
+		 * \return The number of held arrivals released.
 		 */
-		size_type parent(size_type id) const{
-			return (id - 1)/arity;
+		size_type ReleaseStale(){
+			if (!holds){
+				return 0;
+			}
+			const std::uint64_t now = backoff_detail::rdtsc();
+			return release_held(now > staleness_ticks ? now - staleness_ticks : 0, now, false);
 		}
 
 		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
+		 * Sets the observer that is notified of the transitions of the root between 0 and nonzero (see root_observer.hpp). It should be
+		 * set before the SNZI object is used.
 		 */
-		static size_type nodes_count(size_type K, size_type H){
-			assert(K != 1);
-			return (pow_int(K,H+1) - 1)/(K-1);
+		void set_root_observer(const root_observer& observer){
+			root.observer = observer;
+		}
+
+		/**
+		 * Sets the number of backoff rounds that an Arrive operation which finds the counter of a node 0 and its announce flag set waits for
+		 * the announced Arrive operation to complete before propagating on its own (16 by default).
+		 *
+		 * Note that this function doesn't guarantee memory visibility of the new value. It should be called before the SNZI object is shared.
+		 */
+		void set_announce_delay(std::size_t rounds){
+			announce_delay = rounds;
+		}
+
+	private:
+		tree_shape shape; //! The shape of the SNZI tree
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this SNZI object
+		static const std::size_t default_announce_delay = 16; //! The initial value of announce_delay
+		std::size_t announce_delay{default_announce_delay}; //! Backoff rounds an Arrive operation waits for an announced Arrive operation
+		departure_hysteresis hysteresis; //! The hysteresis of the departures (see set_departure_hysteresis())
+		std::uint64_t staleness_ticks{0}; //! hysteresis.staleness_ns in time stamp counter ticks
+		std::unique_ptr<held_arrival[]> holds; //! The arrival that each node holds at its parent, by node index; nullptr without hysteresis
+		mutable root_node root; //! The root SNZI object of the tree; mutable because a query may release stale held arrivals
+		node_array<interior_node> interior{nullptr}; //! The interior SNZI objects of the tree
+		node_array<leaf_node> leaves{nullptr}; //! The leaf SNZI objects of the tree
+
+		void arrive_at_parent(size_type parent){
+			switch(parent){
+			case 0:
+				root.Arrive();
+				break;
+			default:
+				interior[parent].Arrive(*this, parent);
+				break;
+			}
+		}
+
+		void depart_at_parent(size_type parent) const{
+			switch(parent){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				interior[parent].Depart(*this, parent);
+				break;
+			}
+		}
+
+		// the node with index id propagates its transition from 0; the arrival that it holds at the parent, if any, is taken back
+		void arrive_from(size_type id, size_type parent){
+			if (holds && holds[id].take()){
+				return ;
+			}
+			arrive_at_parent(parent);
+		}
+
+		// the node with index id propagates its transition to 0; with hysteresis it holds on to its arrival at the parent and takes the
+		// turn of releasing the stale held arrivals if it has come, so the queries find the turns taken while the tree is busy
+		void depart_from(size_type id, size_type parent) const{
+			if (holds && holds[id].hold(hysteresis.max_rearrivals)){
+				expire_held();
+				return ;
+			}
+			depart_at_parent(parent);
+		}
+
+		bool query_node(size_type id) const{
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			return id < first_leaf ? interior[id].Query() : leaves[id - first_leaf].Query();
 		}
 
 		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
+		 * If hysteresis is on and a turn has come (once per staleness bound, for the queries and the Depart operations together), releases
+		 * the held arrivals that are past the bound. The release only changes the nodes, whose arrays are not part of the object, and the
+		 * root, which is mutable: the held arrivals are not part of the value of the tree, so a const query may release them.
+		 *
+		 * \return True if some held arrival was released.
 		 */
-		static size_type leaves_count(size_type K, size_type H){
-			return pow_int(K,H);
+		bool expire_held() const{
+			if (!holds){
+				return false;
+			}
+
+			const std::uint64_t now = backoff_detail::rdtsc();
+			std::uint64_t due = root.next_sweep.load(std::memory_order_relaxed);
+			if (now < due || !root.next_sweep.compare_exchange_strong(due, now + staleness_ticks, std::memory_order_relaxed, std::memory_order_relaxed)){
+				return false;
+			}
+
+			return release_held(now > staleness_ticks ? now - staleness_ticks : 0, now, false) != 0;
 		}
 
 		/**
-		 * \return b raised to the power of e.
+		 * Departs from the parents of the nodes whose held arrival was held before stale_before or at or after fresh_from (all of them if
+		 * all is true). The nodes are visited from the leaves up, so the arrivals that the releases leave held at the parents, which are
+		 * held at or after fresh_from, are released in the same pass.
+		 *
+		 * \return The number of held arrivals released.
 		 */
-		static size_type pow_int(size_type b, size_type e){
-			size_type result = 1;
-			for (size_type i = 1; i <= e; ++i){
-				result *= b;
+		size_type release_held(std::uint64_t stale_before, std::uint64_t fresh_from, bool all) const{
+			if (!holds){
+				return 0;
+			}
+			if (all){
+				stale_before = static_cast<std::uint64_t>(-1);
 			}
-			return result;
+
+			size_type released = 0;
+			for (size_type id = total_nodes; id-- > 1; ){
+				if (holds[id].release(stale_before, fresh_from)){
+					depart_at_parent(shape.parent(id));
+					++released;
+				}
+			}
+			return released;
+		}
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (for Arrive and Depart operations).
+		 *
+		 * \param tid The id of the thread calling the Arrive or Depart operations.
+		 * \return The index of the leaf where that thread should call its Arrive and Depart operations.
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			/**
+			 * Thread with this id will use the id/r-th leaf node.
+			 * If we have n total nodes and l leaf nodes then the leaf nodes start at index
+			 * l_offset=n-l, and thus the thread with this id will be assigned
+			 * to leaf node l_offset + i/r (which is stored at index i/r of the leaves array). To avoid cases where i/r exceeds the possible range
+			 * of leaf nodes we use i/r mod l.
+			 */
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
 		}
 	};
 
-	class full_contention_handling_snzi{
+	using semi_contention_handling_snzi = basic_semi_contention_handling_snzi<>;
+
+	/**
+	 * The layout of the nodes is chosen by two layout policies (see snzi_layout.hpp): LeafLayout for the leaves and InteriorLayout for the
+	 * nodes between the root and the leaves. The default, split_layout, places X and announce on separate cache lines. compact_layout keeps
+	 * the announce flag in the high bit of X so that the announce check and the counter CAS touch a single line, and packed_layout additionally
+	 * drops the padding so that several nodes share a line; the latter is meant for the interior levels, which see few operations by design,
+	 * when thousands of indicators are used and their footprint matters more than the false sharing between interior nodes. fetch_add_layout
+	 * replaces the CAS loops with a single fetch_add or fetch_sub, so operations on a busy leaf that find it nonzero never retry.
+	 *
+	 * Backoff is the backoff policy (see backoff.hpp) used while waiting for an announced Arrive operation to complete and between the
+	 * failed attempts of ArriveDirectly(). The number of backoff rounds of the former wait is set with set_announce_delay().
+	 */
+	template<typename LeafLayout = split_layout, typename InteriorLayout = LeafLayout, typename Backoff = exponential_backoff>
+	class basic_full_contention_handling_snzi{
 	public:
 		using size_type = std::size_t; //! For sizes and thread identifiers
 
@@ -565,38 +986,104 @@ namespace concurrent{
 			bool use_snzi_in_arrive{false};
 			bool use_snzi_in_depart{false};
 			bool use_snzi_tree_flag{false};
+			int contended_direct_ops{0}; //! Consecutive direct arrivals that were combined (see set_root_combining())
 		};
 
 	private:
 		using counter_type = std::uint64_t; //! Type used for the counter at each SNZI node
 
+		/**
+		 * The request of a thread to the combiner of the root: 0 for none, +1 or -1 while it waits to be applied, and +2 or -2 once the
+		 * combiner has taken it.
+		 */
+		struct combining_slot{
+			// to avoid false sharing with the slots of other threads
+			alignas(CACHE_LINE_SIZE) std::atomic<int> request;
+
+			combining_slot(){
+				request.store(0, snzi_order::init);
+			}
+		};
+
 		struct root_node{
 			// to avoid false sharing with other snzi nodes
 			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			root_observer observer; //! Notified of the transitions between 0 and nonzero
+			alignas(CACHE_LINE_SIZE) std::atomic<bool> combining; //! Held by the thread that applies the requests of the slots
+			std::unique_ptr<combining_slot[]> slots{nullptr}; //! One per thread if the direct operations are combined, nullptr otherwise
+			size_type slot_count{0}; //! The number of slots
 
 			root_node(){
-				X.store(0);
+				X.store(0, snzi_order::init);
+				combining.store(false, snzi_order::init);
+			}
+
+			// moves the value of the counter, for the move operations of the tree (which require a quiescent tree)
+			root_node(root_node&& other) : root_node(){
+				move_from(other);
+			}
+
+			root_node& operator=(root_node&& other){
+				move_from(other);
+				return *this;
 			}
 
-			void ArriveDirectly(contention_status& cont){
-				counter_type oldx = X.load();
+			// takes the counter, the observer and the slots of other; the combiner flag starts released
+			void move_from(root_node& other){
+				X.store(other.X.load(snzi_order::probe), snzi_order::init);
+				observer = other.observer;
+				combining.store(false, snzi_order::init);
+				slots = std::move(other.slots);
+				slot_count = other.slot_count;
+			}
+
+			void ArriveDirectly(size_type tid, contention_status& cont){
+				counter_type oldx = X.load(snzi_order::probe);
+
+				if (slots){
+					if (X.compare_exchange_strong(oldx, oldx + 1, snzi_order::root_arrive, snzi_order::cas_failure)){
+						if (!oldx){
+							observer.notify();
+						}
+						cont.contended_direct_ops = 0;
+						return ;
+					}
+
+					// contended: let a single thread apply the arrivals and departures of every waiting thread
+					combine(tid, 1);
+					if (++cont.contended_direct_ops >= contention_status::MaxContentionNumFailures){
+						// the next time use the snzi tree
+						cont.use_snzi_tree_flag = true;
+					}
+					return ;
+				}
 
-				exponential_backoff backoff;
+				Backoff backoff;
 				int num_failures{0};
 
-				while (!X.compare_exchange_weak(oldx, oldx + 1)){
+				while (!X.compare_exchange_weak(oldx, oldx + 1, snzi_order::root_arrive, snzi_order::cas_failure)){
 					++num_failures;
 					backoff.backoff();
 				}
 
+				if (!oldx){
+					observer.notify();
+				}
+
 				if (num_failures >= contention_status::MaxContentionNumFailures){
 					// the next time use the snzi tree
 					cont.use_snzi_tree_flag = true;
 				}
 			}
 
-			void DepartDirectly(contention_status& cont){
-				Depart();
+			void DepartDirectly(size_type tid, contention_status& cont){
+				if (slots && combining.load(std::memory_order_relaxed)){
+					// a combiner is at work; join its batch instead of contending with it
+					combine(tid, -1);
+				}
+				else{
+					Depart();
+				}
 
 				if (cont.use_snzi_tree_flag){
 					cont.use_snzi_in_arrive = cont.use_snzi_in_depart = true;
@@ -604,102 +1091,208 @@ namespace concurrent{
 			}
 
 			void Arrive(){
-				X.fetch_add(1);
+				if (!X.fetch_add(1, snzi_order::root_arrive)){
+					observer.notify();
+				}
 			}
 
 			void Depart(){
-				X.fetch_sub(1);
+				if (X.fetch_sub(1, snzi_order::root_depart) == 1){
+					observer.notify();
+				}
 			}
 
 			bool Query() const{
-				return X.load() != 0;
+				return X.load(snzi_order::query) != 0;
+			}
+
+			/**
+			 * Publishes the request delta (+1 or -1) of thread tid and returns once a combiner, possibly the thread itself, has applied it.
+			 */
+			void combine(size_type tid, int delta){
+				assert(tid < slot_count);
+
+				std::atomic<int>& request = slots[tid].request;
+				request.store(delta, std::memory_order_release);
+
+				for (;;){
+					if (!combining.exchange(true, std::memory_order_acquire)){
+						// our own request is among the ones we apply
+						apply_requests();
+						combining.store(false, std::memory_order_release);
+						return ;
+					}
+
+					Backoff backoff;
+					while (request.load(std::memory_order_acquire) && combining.load(std::memory_order_relaxed)){
+						backoff.backoff();
+					}
+					if (!request.load(std::memory_order_acquire)){
+						return ;
+					}
+				}
+			}
+
+			/**
+			 * Applies the net delta of the pending requests with a single atomic instruction. Called by the combiner.
+			 */
+			void apply_requests(){
+				counter_type arrivals = 0;
+				counter_type departures = 0;
+
+				// take the pending requests; a thread does not publish another one until its request is cleared
+				for (size_type i = 0; i < slot_count; ++i){
+					const int r = slots[i].request.load(std::memory_order_acquire);
+					if (r == 1 || r == -1){
+						if (r > 0){
+							++arrivals;
+						}
+						else{
+							++departures;
+						}
+						slots[i].request.store(2*r, std::memory_order_relaxed);
+					}
+				}
+
+				if (arrivals != departures){
+					// the arrivals are ordered before the departures, so the root goes through at most one 0 to nonzero transition
+					// and one nonzero to 0 transition
+					const counter_type oldx = X.fetch_add(arrivals - departures, snzi_order::arrive);
+					if (!oldx && arrivals){
+						observer.notify();
+					}
+					if (oldx + arrivals - departures == 0 && oldx + arrivals){
+						observer.notify();
+					}
+				}
+
+				for (size_type i = 0; i < slot_count; ++i){
+					const int r = slots[i].request.load(std::memory_order_relaxed);
+					if (r == 2 || r == -2){
+						slots[i].request.store(0, std::memory_order_release);
+					}
+				}
 			}
 		};
 
+		/**
+		 * A SNZI node whose counter and announce flag are stored according to Layout (see snzi_layout.hpp).
+		 * The update_path of the cell selects between the CAS loops and the fetch_add path of fetch_add_layout.
+		 */
+		template<typename Layout>
 		struct node{
-			// to avoid false sharing with other snzi nodes
-			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
-			alignas(CACHE_LINE_SIZE) std::atomic<bool> announce;
+			using cell_type = typename Layout::template cell<counter_type>;
+
+			cell_type state;
 			size_type parent;
-			full_contention_handling_snzi* snzi_tree;
 
-			node(){
-				X.store(0);
-				announce.store(false);
+			void Arrive(basic_full_contention_handling_snzi& snzi_tree){
+				arrive(snzi_tree, typename cell_type::update_path{});
 			}
 
-			void Arrive(){
+			bool Query() const{
+				return state.count(state.word().load(snzi_order::query)) != 0;
+			}
+
+			void Depart(basic_full_contention_handling_snzi& snzi_tree){
+				depart(snzi_tree, typename cell_type::update_path{});
+			}
+
+			void arrive(basic_full_contention_handling_snzi& snzi_tree, cas_update){
 				bool pArrInv = false;
 
-				counter_type oldx = X.load();
+				counter_type oldx = state.load();
 
 				do{
-					if (!oldx && !pArrInv){
+					if (!state.count(oldx) && !pArrInv){
 						bool doArrive = true;
-						if (announce.load()){
-							exponential_backoff backoff;
-							const int DelayAmount = 16;
-							for (int i = 0; i < DelayAmount; ++i){
-								oldx = X.load();
-								if (oldx){ doArrive = false; break; }
-								backoff.backoff();
+						if (state.announced(oldx)){
+							Backoff backoff;
+							for (std::size_t i = 0; i < snzi_tree.announce_delay; ++i){
+								oldx = state.load();
+								if (state.count(oldx)){ doArrive = false; break; }
+								backoff_traits<Backoff>::wait(backoff, state.word(), oldx);
 							}
 						}
 						if (doArrive){
-							announce.store(true);
-							switch(parent){
-							case 0:
-								snzi_tree->root.Arrive();
-								break;
-							default:
-								snzi_tree->others[parent].Arrive();
-								break;
-							}
+							state.set_announce(oldx);
+							snzi_tree.arrive_at_parent(parent);
 							pArrInv = true;
 						}
 					}
-				} while (!X.compare_exchange_weak(oldx, oldx + 1));
+				} while (!state.increment(oldx));
 
-				if (pArrInv && oldx){
-					switch(parent){
-					case 0:
-						snzi_tree->root.Depart();
-						break;
-					default:
-						snzi_tree->others[parent].Depart();
-						break;
-					}
+				if (!state.count(oldx)){
+					// wake the threads that wait for the announced Arrive operation to complete
+					backoff_traits<Backoff>::notify(state.word());
+				}
+
+				if (pArrInv && state.count(oldx)){
+					snzi_tree.depart_at_parent(parent);
 				}
 			}
 
-			void Depart(){
-				counter_type oldx = X.load();
+			void depart(basic_full_contention_handling_snzi& snzi_tree, cas_update){
+				counter_type oldx = state.load();
 
-				do{
-					if (oldx == 1){
-						announce.store(false);
+				while (!state.decrement(oldx)){}
+
+				if (state.count(oldx) == 1){
+					snzi_tree.depart_at_parent(parent);
+				}
+			}
+
+			void arrive(basic_full_contention_handling_snzi& snzi_tree, fetch_add_update){
+				counter_type oldx = state.fetch_increment();
+
+				if (state.settled(oldx)){
+					// the parent holds the arrival of this node and cannot lose it while we are counted
+					return ;
+				}
+
+				if (state.count(oldx)){
+					// the thread that took the counter from 0 propagates the arrival; wait for it as for an announced Arrive operation
+					oldx = state.observe();
+					Backoff backoff;
+					for (std::size_t i = 0; i < snzi_tree.announce_delay && !state.settled(oldx); ++i){
+						backoff_traits<Backoff>::wait(backoff, state.word(), oldx);
+						oldx = state.observe();
 					}
-					// use a strong version here to avoid the possibility of a spurious failure while oldx == 1
-					// that would lead to two stores to announce
-				} while (!X.compare_exchange_strong(oldx, oldx - 1));
+				}
 
-				if (oldx == 1){
-					switch(parent){
-					case 0:
-						snzi_tree->root.Depart();
-						break;
-					default:
-						snzi_tree->others[parent].Depart();
-						break;
+				if (state.settled(oldx)){
+					return ;
+				}
+
+				snzi_tree.arrive_at_parent(parent);
+
+				while (!state.settled(oldx)){
+					if (state.settle(oldx)){
+						// wake the threads that wait for the arrival to be propagated
+						backoff_traits<Backoff>::notify(state.word());
+						return ;
 					}
 				}
+
+				// another thread published its arrival at the parent first
+				snzi_tree.depart_at_parent(parent);
+			}
+
+			void depart(basic_full_contention_handling_snzi& snzi_tree, fetch_add_update){
+				counter_type oldx = state.fetch_decrement();
+
+				if (state.count(oldx) == 1 && state.unsettle()){
+					snzi_tree.depart_at_parent(parent);
+				}
 			}
 		};
 
+		using interior_node = node<InteriorLayout>; //! Nodes that are neither the root nor leaves
+		using leaf_node = node<LeafLayout>; //! Nodes where the threads call their operations
+
 	public:
 
 		friend class root_node;
-		friend class node;
 
 		/**
 		 * Constructs a SNZI perfect K-ary tree with height H. T specifies the maximum number of threads that will use the SNZI object.
@@ -714,49 +1307,78 @@ namespace concurrent{
 		 * \param K The arity of the SNZI tree
 		 * \param H The height of the SNZI tree
 		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
 		 * \throws std::invalid_argument If at least one of the restrictions is not satisfied.
 		 */
-		full_contention_handling_snzi(size_type K, size_type H, size_type T){
-			if (K < 2){
-				throw std::invalid_argument("K parameter in snzi constructor must be >= 2");
-			}
+		basic_full_contention_handling_snzi(size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : basic_full_contention_handling_snzi(tree_shape::uniform(K,H), T, arena){}
 
-			// the total number of nodes in the K-ary tree of height H.
-			total_nodes = nodes_count(K,H);
-			total_leaf_nodes = leaves_count(K,H);
+		/**
+		 * Constructs a SNZI tree whose levels have the given fan-outs, listed from the root downwards (see tree_shape).
+		 * T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * \param fanout The number of children of the nodes at each level; its size is the height of the tree
+		 * \param T The number of threads to use this SNZI object
+		 * \param arena The arena that holds the nodes (see snzi_arena.hpp), or nullptr for the heap
+		 * \throws std::invalid_argument If any fan-out is lower than 2.
+		 */
+		basic_full_contention_handling_snzi(const std::vector<size_type>& fanout, size_type T, snzi_arena* arena = nullptr) : basic_full_contention_handling_snzi(tree_shape(fanout), T, arena){}
+
+		/**
+		 * Constructs a SNZI tree with the given shape. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * The nodes are allocated from arena (see snzi_arena.hpp), which must outlive the SNZI object, or from the heap if arena is nullptr.
+		 */
+		basic_full_contention_handling_snzi(const tree_shape& shape, size_type T, snzi_arena* arena = nullptr) : shape(shape){
+			// the total number of nodes in the tree.
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
 			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
 			if (!threads_per_leaf){
 				threads_per_leaf = 1;
 			}
 			total_threads = T;
-			arity = K;
 
 			/**
 			 * We place the root node in its own (in the local variable root because it is special). That means
-			 * we are left with n-1 other nodes to allocate in local variable others.
+			 * we are left with n-1 other nodes of which the l leaves are allocated in local variable leaves and the rest in local variable interior.
 			 * But, because the children of the root node which has index 0 are 1,2,... we do not use the 0 index of the
-			 * others array and, thus, instead of n-1 nodes we allocate n nodes in the others array.
-			 * This also allow us to index the leaf nodes in the others array with their normal indices.
+			 * interior array and, thus, instead of n-l-1 nodes we allocate n-l nodes in the interior array.
+			 * This also allow us to index the interior nodes in the interior array with their normal indices. The leaves, which
+			 * may use a different layout, are kept in the leaves array starting from index 0.
 			 */
-			others.reset(new node[total_nodes]);
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			interior = make_node_array<interior_node>(arena, first_leaf);
+			leaves = make_node_array<leaf_node>(arena, total_leaf_nodes);
 
-			// We must set the snzi pointer in the other nodes so that they can navigate in the tree (to find their parents)
-			// and tell them which is their id
-			for (size_type i = 1; i < total_nodes; ++i){
-				others[i].snzi_tree = this;
-				others[i].parent = parent(i);
+			// We must tell the other nodes which is their parent so that they can navigate in the tree
+			for (size_type i = 1; i < first_leaf; ++i){
+				interior[i].parent = shape.parent(i);
+			}
+			for (size_type i = first_leaf ? first_leaf : 1; i < total_nodes; ++i){
+				leaves[i - first_leaf].parent = shape.parent(i);
 			}
 		}
 
+		/**
+		 * Moves a SNZI object. The nodes find each other through their indices and the tree that they are called on, so the moved object
+		 * works at its new address and the objects can be kept by value, e.g. in a std::vector. Only a quiescent object (no operation in
+		 * progress and none until the move completes) may be moved; the moved-from object may only be destroyed or assigned to.
+		 */
+		basic_full_contention_handling_snzi(basic_full_contention_handling_snzi&&) = default;
+		basic_full_contention_handling_snzi& operator=(basic_full_contention_handling_snzi&&) = default;
+
 		/**
 		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
 		 *
-		 * An Arrive() operation by a thread should be matched by a Depart() operation.
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid, cont) or
+		 * by any thread with Depart(token), where token is the value returned by Arrive().
+		 *
+		 * \return The token that identifies the node at which the thread arrived (the root for a direct arrival).
 		 */
-		void Arrive(size_type tid, contention_status& cont){
+		arrival_token Arrive(size_type tid, contention_status& cont){
 			if (!cont.use_snzi_in_arrive){
-				root.ArriveDirectly(cont);
-				return ;
+				root.ArriveDirectly(tid, cont);
+				return arrival_token(0);
 			}
 
 			size_type leaf = get_leaf_for_thread(tid);
@@ -766,9 +1388,11 @@ namespace concurrent{
 				root.Arrive();
 				break;
 			default:
-				others[leaf].Arrive();
+				leaves[leaf - (total_nodes - total_leaf_nodes)].Arrive(*this);
 				break;
 			}
+
+			return arrival_token(leaf);
 		}
 
 		/**
@@ -777,7 +1401,7 @@ namespace concurrent{
 		 */
 		void Depart(size_type tid, contention_status& cont){
 			if (!cont.use_snzi_in_depart){
-				root.DepartDirectly(cont);
+				root.DepartDirectly(tid, cont);
 				return ;
 			}
 
@@ -788,7 +1412,25 @@ namespace concurrent{
 				root.Depart();
 				break;
 			default:
-				others[leaf].Depart();
+				leaves[leaf - (total_nodes - total_leaf_nodes)].Depart(*this);
+				break;
+			}
+		}
+
+		/**
+		 * Departs from the node at which the Arrive() operation that returned token arrived. It may be called by any thread, once per token.
+		 *
+		 * The switch of a thread from direct arrivals to the tree is made by Depart(tid, cont), which this operation does not see. A thread
+		 * whose direct arrivals are all departed through tokens may make the switch itself once cont.use_snzi_tree_flag is set, by setting
+		 * cont.use_snzi_in_arrive; its tokens say where each earlier arrival must depart.
+		 */
+		void Depart(arrival_token token){
+			switch(token.node()){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				leaves[token.node() - (total_nodes - total_leaf_nodes)].Depart(*this);
 				break;
 			}
 		}
@@ -802,69 +1444,153 @@ namespace concurrent{
 			return root.Query();
 		}
 
-	private:
-		size_type arity; //! The arity of the SNZI tree
-		size_type total_nodes; //! Total number on nodes in the SNZI tree
-		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
-		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
-		size_type total_threads; //! Number of threads to use this SNZI object
-		root_node root; //! The root SNZI object of the tree
-		std::unique_ptr<node[]> others{nullptr}; //! The other SNZI objects of the tree
+		/**
+		 * Tests whether there is an "active" thread among the threads assigned to the leaves of the subtree rooted at the node with index id
+		 * (the nodes are numbered in level order, see tree_shape). The answer is read from the counter of that node, which is what its parent
+		 * sees, so it is as cheap as Query() and does not disturb the other subtrees. QuerySubtree(0) is Query().
+		 *
+		 * The arrivals of the threads that arrive directly at the root (see contention_status) are not attributed to any subtree, so they
+		 * are only seen by Query().
+		 *
+		 * \param id The index of the node, in the range [0,number of nodes)
+		 * \return True if there is a surplus of Arrive operations from Depart operations in the subtree.
+		 */
+		bool QuerySubtree(size_type id) const{
+			assert(id < total_nodes);
+
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			if (!id){
+				return root.Query();
+			}
+			return id < first_leaf ? interior[id].Query() : leaves[id - first_leaf].Query();
+		}
 
 		/**
-		 * Returns the index of the leaf node in the others array where the thread with the given id is assigned (for Arrive and Depart operations).
+		 * Tests whether there is an "active" thread in the cache-sharing domain that maps to the node at position index of level depth. For
+		 * example, on a tree with the fan-outs {sockets, cores per socket, threads per core} QueryDomain(1, s) tells whether a thread of
+		 * socket s is present.
 		 *
-		 * \param tid The id of the thread calling the Arrive or Depart operations.
-		 * \return The index of the leaf where that thread should call its Arrive and Depart operations.
+		 * \param depth The level of the domain, at most the height of the tree
+		 * \param index The position of the domain in its level, lower than the number of nodes of the level
+		 * \return QuerySubtree() of the node at position index of level depth.
 		 */
-		size_type get_leaf_for_thread(size_type tid) const{
-			/**
-			 * Thread with this id will use the id/r-th leaf node.
-			 * If we have n total nodes and l leaf nodes then the leaf nodes start at index
-			 * l_offset=n-l in the others array, and thus the thread with this id will be assigned
-			 * to leaf node l_offset + i/r in the other array. To avoid cases where i/r exceeds the possible range
-			 * of leaf nodes we use i/r mod l.
-			 */
-			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		bool QueryDomain(size_type depth, size_type index) const{
+			return QuerySubtree(shape.node_at(depth, index));
 		}
 
 		/**
-		 * Returns the index of the parent of the node with index id.
+		 * Returns a quiescent SNZI object (no thread has arrived and no operation is in progress) to the state in which the constructor
+		 * leaves it, without allocating: the counters and flags of the nodes are cleared, the announce delay is set back to its default and
+		 * the root observer is removed. The setting of set_root_combining() is kept. This is much cheaper than constructing a new object,
+		 * so short-lived indicators can be reused (see snzi_pool.hpp).
 		 *
-		 * \param id The index of the node
-		 * \return The index of id's parent
+		 * Like the constructor, it doesn't guarantee memory visibility of the new state. This should be established by other means.
 		 */
-		size_type parent(size_type id) const{
-			return (id - 1)/arity;
+		void reset(){
+			const size_type first_leaf = total_nodes - total_leaf_nodes;
+			for (size_type i = 1; i < first_leaf; ++i){
+				interior[i].state.reset();
+			}
+			for (size_type i = 0; i < total_leaf_nodes; ++i){
+				leaves[i].state.reset();
+			}
+			announce_delay = default_announce_delay;
+			root.X.store(0, snzi_order::init);
+			root.observer = root_observer();
 		}
 
 		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
+		 * Turns flat combining of the direct operations at the root on or off (off by default).
+		 *
+		 * Without it, a thread that arrives directly at the root retries its CAS with backoff, and N threads that arrive at once make up to
+		 * N^2 attempts on the line of the root. With it, a direct arrival whose first CAS fails publishes its +1 in a slot of its own and the
+		 * first waiting thread that acquires the combiner flag applies the net delta of all the published requests with a single fetch_add
+		 * and releases their threads; a direct departure joins the batch if a combiner is at work and is a plain fetch_sub otherwise. A burst
+		 * thus costs one atomic instruction on the root per batch. The switch to the tree is kept for sustained contention: after
+		 * contention_status::MaxContentionNumFailures consecutive combined arrivals the thread uses the tree, as after that many failed CAS
+		 * operations without combining.
+		 *
+		 * The slots take a cache line per thread and are indexed by the thread identifiers, which must then be in the range [0,T) for the
+		 * direct operations as well. Like the constructor, this function doesn't guarantee memory visibility; it should be called before
+		 * the SNZI object is shared.
 		 */
-		static size_type nodes_count(size_type K, size_type H){
-			assert(K != 1);
-			return (pow_int(K,H+1) - 1)/(K-1);
+		void set_root_combining(bool enabled){
+			root.slot_count = enabled ? (total_threads ? total_threads : 1) : 0;
+			root.slots.reset(enabled ? new combining_slot[root.slot_count] : nullptr);
 		}
 
 		/**
-		 * \return The number of nodes in a perfect K-ary tree of height H.
+		 * Sets the observer that is notified of the transitions of the root between 0 and nonzero (see root_observer.hpp). It should be
+		 * set before the SNZI object is used.
 		 */
-		static size_type leaves_count(size_type K, size_type H){
-			return pow_int(K,H);
+		void set_root_observer(const root_observer& observer){
+			root.observer = observer;
 		}
 
 		/**
-		 * \return b raised to the power of e.
+		 * Sets the number of backoff rounds that an Arrive operation which finds the counter of a node 0 and its announce flag set waits for
+		 * the announced Arrive operation to complete before propagating on its own (16 by default).
+		 *
+		 * Note that this function doesn't guarantee memory visibility of the new value. It should be called before the SNZI object is shared.
 		 */
-		static size_type pow_int(size_type b, size_type e){
-			size_type result = 1;
-			for (size_type i = 1; i <= e; ++i){
-				result *= b;
+		void set_announce_delay(std::size_t rounds){
+			announce_delay = rounds;
+		}
+
+	private:
+		tree_shape shape; //! The shape of the SNZI tree
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this SNZI object
+		static const std::size_t default_announce_delay = 16; //! The initial value of announce_delay
+		std::size_t announce_delay{default_announce_delay}; //! Backoff rounds an Arrive operation waits for an announced Arrive operation
+		root_node root; //! The root SNZI object of the tree
+		node_array<interior_node> interior{nullptr}; //! The interior SNZI objects of the tree
+		node_array<leaf_node> leaves{nullptr}; //! The leaf SNZI objects of the tree
+
+		void arrive_at_parent(size_type parent){
+			switch(parent){
+			case 0:
+				root.Arrive();
+				break;
+			default:
+				interior[parent].Arrive(*this);
+				break;
 			}
-			return result;
+		}
+
+		void depart_at_parent(size_type parent){
+			switch(parent){
+			case 0:
+				root.Depart();
+				break;
+			default:
+				interior[parent].Depart(*this);
+				break;
+			}
+		}
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (for Arrive and Depart operations).
+		 *
+		 * \param tid The id of the thread calling the Arrive or Depart operations.
+		 * \return The index of the leaf where that thread should call its Arrive and Depart operations.
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			/**
+			 * Thread with this id will use the id/r-th leaf node.
+			 * If we have n total nodes and l leaf nodes then the leaf nodes start at index
+			 * l_offset=n-l, and thus the thread with this id will be assigned
+			 * to leaf node l_offset + i/r (which is stored at index i/r of the leaves array). To avoid cases where i/r exceeds the possible range
+			 * of leaf nodes we use i/r mod l.
+			 */
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
 		}
 	};
 
+	using full_contention_handling_snzi = basic_full_contention_handling_snzi<>;
+
 } // namespace concurrent
 
 
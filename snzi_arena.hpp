@@ -0,0 +1,214 @@
+#ifndef SNZI_ARENA_HPP_
+#define SNZI_ARENA_HPP_
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <sys/mman.h>
+#include "config.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class snzi_arena provides the storage of the nodes of many SNZI trees from one large mapping, so that thousands of indicators do not
+	 * make thousands of small heap allocations scattered over 4 KB pages. The mapping is backed by 2 MB huge pages when possible: it is
+	 * first requested with MAP_HUGETLB (which needs huge pages reserved by the administrator, see /proc/sys/vm/nr_hugepages) and otherwise
+	 * mapped normally and advised with MADV_HUGEPAGE, so that transparent huge pages back it. It can optionally be locked in memory with
+	 * mlock, so that propagations never take a page fault.
+	 *
+	 * Blocks are handed out in whole cache lines, so the nodes keep their padding. A freed block is kept on a free list for its size and
+	 * reused by the next allocation of the same size; since the trees of a family of indicators have the same shape, constructing and
+	 * destroying an indicator costs O(1) allocator work. Memory is only returned to the system when the arena is destroyed, which must
+	 * happen after all the trees that use it are destroyed.
+	 *
+	 * The SNZI classes of snzi.hpp take an optional snzi_arena* in their constructors. allocate() and deallocate() are thread-safe.
+	 */
+	class snzi_arena{
+	public:
+		using size_type = std::size_t; //! For sizes
+
+		static const size_type huge_page_size = size_type(2) << 20; //! The size of the huge pages backing the arena
+
+		/**
+		 * Maps an arena of at least capacity bytes (rounded up to whole huge pages).
+		 *
+		 * \param capacity The number of bytes available to the trees
+		 * \param lock Whether to lock the arena in memory with mlock
+		 * \throws std::invalid_argument If capacity is 0.
+		 * \throws std::bad_alloc If the arena cannot be mapped.
+		 * \throws std::system_error If lock is set and mlock fails (e.g. because of RLIMIT_MEMLOCK).
+		 */
+		explicit snzi_arena(size_type capacity, bool lock = false){
+			if (!capacity){
+				throw std::invalid_argument("capacity in snzi_arena constructor must be > 0");
+			}
+
+			total_bytes = (capacity + huge_page_size - 1)/huge_page_size*huge_page_size;
+
+#ifdef MAP_HUGETLB
+			base = mmap(nullptr, total_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			explicit_huge_pages = (base != MAP_FAILED);
+#endif
+			if (!explicit_huge_pages){
+				base = mmap(nullptr, total_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (base == MAP_FAILED){
+					throw std::bad_alloc();
+				}
+#ifdef MADV_HUGEPAGE
+				madvise(base, total_bytes, MADV_HUGEPAGE);
+#endif
+			}
+
+			if (lock){
+				if (mlock(base, total_bytes)){
+					const int error = errno;
+					munmap(base, total_bytes);
+					throw std::system_error(error, std::system_category(), "mlock of snzi_arena failed");
+				}
+				locked = true;
+			}
+		}
+
+		snzi_arena(const snzi_arena&) = delete;
+		snzi_arena& operator=(const snzi_arena&) = delete;
+
+		~snzi_arena(){
+			munmap(base, total_bytes);
+		}
+
+		/**
+		 * \param bytes The size of the block
+		 * \param alignment The alignment of the block, a power of 2 (nodes padded beyond a cache line need more than CACHE_LINE_SIZE)
+		 * \return A block of at least bytes bytes, aligned to CACHE_LINE_SIZE and to alignment.
+		 * \throws std::bad_alloc If the arena is exhausted.
+		 */
+		void* allocate(size_type bytes, size_type alignment = CACHE_LINE_SIZE){
+			const size_type lines = lines_for(bytes);
+
+			std::lock_guard<std::mutex> guard(free_lists_lock);
+
+			// the freed blocks of a size were allocated for the same kind of nodes, so the head is aligned unless the kinds are mixed
+			if (lines < free_lists.size() && free_lists[lines] && !(reinterpret_cast<std::uintptr_t>(free_lists[lines]) % alignment)){
+				free_block* block = free_lists[lines];
+				free_lists[lines] = block->next;
+				return block;
+			}
+
+			size_type offset = used_bytes;
+			if (alignment > CACHE_LINE_SIZE){
+				offset = (offset + alignment - 1)/alignment*alignment;
+			}
+			if (offset > total_bytes || lines > (total_bytes - offset)/CACHE_LINE_SIZE){
+				throw std::bad_alloc();
+			}
+			used_bytes = offset + lines*CACHE_LINE_SIZE;
+			return static_cast<char*>(base) + offset;
+		}
+
+		/**
+		 * Returns a block obtained from allocate(bytes), with the same bytes, to the free list of its size.
+		 */
+		void deallocate(void* p, size_type bytes){
+			const size_type lines = lines_for(bytes);
+
+			std::lock_guard<std::mutex> guard(free_lists_lock);
+
+			if (lines >= free_lists.size()){
+				free_lists.resize(lines + 1, nullptr);
+			}
+			free_block* block = static_cast<free_block*>(p);
+			block->next = free_lists[lines];
+			free_lists[lines] = block;
+		}
+
+		/**
+		 * \return The number of bytes of the mapping.
+		 */
+		size_type capacity() const{
+			return total_bytes;
+		}
+
+		/**
+		 * \return True if the arena was mapped with MAP_HUGETLB; otherwise huge pages are only advised and depend on transparent huge pages.
+		 */
+		bool huge_pages() const{
+			return explicit_huge_pages;
+		}
+
+		/**
+		 * \return True if the arena is locked in memory.
+		 */
+		bool is_locked() const{
+			return locked;
+		}
+
+	private:
+		struct free_block{
+			free_block* next;
+		};
+
+		void* base{nullptr}; //! The start of the mapping
+		size_type total_bytes{0}; //! The size of the mapping
+		size_type used_bytes{0}; //! The bytes handed out from the start of the mapping, including the freed blocks
+		bool explicit_huge_pages{false}; //! Whether MAP_HUGETLB succeeded
+		bool locked{false}; //! Whether mlock succeeded
+		std::vector<free_block*> free_lists; //! free_lists[n] heads the freed blocks of n cache lines
+		std::mutex free_lists_lock; //! Protects used_bytes and free_lists
+
+		static size_type lines_for(size_type bytes){
+			return bytes ? (bytes + CACHE_LINE_SIZE - 1)/CACHE_LINE_SIZE : 1;
+		}
+	};
+
+	/**
+	 * The deleter of an array of count nodes that were allocated from arena, or with new[] if arena is nullptr (see make_node_array()).
+	 */
+	template<typename T>
+	struct arena_deleter{
+		snzi_arena* arena{nullptr}; //! The arena of the array, nullptr for the heap
+		std::size_t count{0}; //! The number of elements of the array
+
+		void operator()(T* p) const{
+			if (!arena){
+				delete[] p;
+				return ;
+			}
+			for (std::size_t i = 0; i < count; ++i){
+				p[i].~T();
+			}
+			arena->deallocate(p, count*sizeof(T));
+		}
+	};
+
+	template<typename T>
+	using node_array = std::unique_ptr<T[], arena_deleter<T> >; //! An array of nodes that may live in a snzi_arena
+
+	/**
+	 * \return An array of count default-constructed nodes, allocated from arena or, if arena is nullptr, with new[].
+	 */
+	template<typename T>
+	node_array<T> make_node_array(snzi_arena* arena, std::size_t count){
+		arena_deleter<T> deleter;
+		deleter.arena = arena;
+		deleter.count = count;
+
+		if (!arena){
+			return node_array<T>(new T[count], deleter);
+		}
+
+		T* p = static_cast<T*>(arena->allocate(count*sizeof(T), alignof(T)));
+		for (std::size_t i = 0; i < count; ++i){
+			new (p + i) T;
+		}
+		return node_array<T>(p, deleter);
+	}
+
+} // namespace concurrent
+
+#endif /* SNZI_ARENA_HPP_ */
@@ -0,0 +1,141 @@
+#ifndef SNZI_HANDLE_HPP_
+#define SNZI_HANDLE_HPP_
+
+#include <cstddef>
+#include "snzi.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Describes how a thread calls the operations of a SNZI class: thread_state is the state that a thread passes to the operations besides
+	 * its identifier. The default is for the classes whose operations take only the identifier (no_contention_handling_snzi,
+	 * semi_contention_handling_snzi, adaptive_snzi and static_snzi).
+	 */
+	template<typename Snzi>
+	struct snzi_thread_traits{
+		struct thread_state{};
+
+		static void arrive(Snzi& snzi_object, std::size_t tid, thread_state&){
+			snzi_object.Arrive(tid);
+		}
+
+		static void depart(Snzi& snzi_object, std::size_t tid, thread_state&){
+			snzi_object.Depart(tid);
+		}
+	};
+
+	/**
+	 * The operations of full_contention_handling_snzi also take the contention_status of the thread.
+	 */
+	template<typename LeafLayout, typename InteriorLayout, typename Backoff>
+	struct snzi_thread_traits<basic_full_contention_handling_snzi<LeafLayout, InteriorLayout, Backoff> >{
+		using snzi_type = basic_full_contention_handling_snzi<LeafLayout, InteriorLayout, Backoff>;
+		using thread_state = typename snzi_type::contention_status;
+
+		static void arrive(snzi_type& snzi_object, std::size_t tid, thread_state& cont){
+			snzi_object.Arrive(tid, cont);
+		}
+
+		static void depart(snzi_type& snzi_object, std::size_t tid, thread_state& cont){
+			snzi_object.Depart(tid, cont);
+		}
+	};
+
+	/**
+	 * Class snzi_handle binds a thread to a SNZI object: it holds the identifier of the thread and the state that the thread passes to
+	 * the operations (see snzi_thread_traits), so the thread calls Arrive() and Depart() without arguments. A handle is used by a single
+	 * thread and there is one handle per thread and SNZI object.
+	 *
+	 * If Reentrant is true the handle counts the nesting of the Arrive operations of its thread. Only the outermost Arrive operation and
+	 * the Depart operation that matches it act on the SNZI object; the nested ones change the counter of the handle and touch no shared
+	 * memory. Nested calls must therefore go through the same handle, for example one that the thread keeps in thread-local storage or
+	 * passes down its call frames.
+	 */
+	template<typename Snzi, bool Reentrant = false>
+	class snzi_handle{
+	public:
+		using size_type = std::size_t; //! For thread identifiers and nesting depths
+
+		/**
+		 * Binds the thread with identifier tid to snzi_object, which must outlive the handle.
+		 */
+		snzi_handle(Snzi& snzi_object, size_type tid) : snzi_object(snzi_object), tid(tid){}
+
+		snzi_handle(const snzi_handle&) = delete;
+		snzi_handle& operator=(const snzi_handle&) = delete;
+
+		/**
+		 * Declares the presence of the thread. In re-entrant mode only the outermost call arrives at the SNZI object.
+		 */
+		void Arrive(){
+			if (Reentrant && nesting++){
+				return ;
+			}
+			snzi_thread_traits<Snzi>::arrive(snzi_object, tid, state);
+		}
+
+		/**
+		 * Matches a previous Arrive() of the thread. In re-entrant mode only the call that matches the outermost Arrive() departs from the SNZI
+		 * object.
+		 */
+		void Depart(){
+			if (Reentrant && --nesting){
+				return ;
+			}
+			snzi_thread_traits<Snzi>::depart(snzi_object, tid, state);
+		}
+
+		/**
+		 * \return The result of Query() on the SNZI object.
+		 */
+		bool Query() const{
+			return snzi_object.Query();
+		}
+
+		/**
+		 * \return The number of Arrive operations of the thread that are not matched by a Depart operation yet (re-entrant mode only).
+		 */
+		size_type depth() const{
+			return nesting;
+		}
+
+		/**
+		 * \return The identifier of the thread bound by this handle.
+		 */
+		size_type thread_id() const{
+			return tid;
+		}
+
+	private:
+		Snzi& snzi_object; //! The SNZI object the thread is bound to
+		size_type tid; //! The identifier of the thread
+		typename snzi_thread_traits<Snzi>::thread_state state; //! The state the thread passes to the operations
+		size_type nesting{0}; //! The nesting depth of the Arrive operations in re-entrant mode
+	};
+
+	template<typename Snzi>
+	using reentrant_snzi_handle = snzi_handle<Snzi, true>;
+
+	/**
+	 * Arrives through a handle on construction and departs on destruction, so a call frame cannot leave without departing.
+	 */
+	template<typename Handle>
+	class scoped_arrival{
+	public:
+		explicit scoped_arrival(Handle& handle) : handle(handle){
+			handle.Arrive();
+		}
+
+		~scoped_arrival(){
+			handle.Depart();
+		}
+
+		scoped_arrival(const scoped_arrival&) = delete;
+		scoped_arrival& operator=(const scoped_arrival&) = delete;
+	private:
+		Handle& handle;
+	};
+
+} // namespace concurrent
+
+#endif /* SNZI_HANDLE_HPP_ */
@@ -0,0 +1,273 @@
+#ifndef SNZI_LAYOUT_HPP_
+#define SNZI_LAYOUT_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <atomic>
+#include "config.hpp"
+#include "cache_line.hpp"
+#include "snzi_ordering.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Layout policies for the nodes of the SNZI trees that use an announce flag (semi_contention_handling_snzi and
+	 * full_contention_handling_snzi).
+	 *
+	 * A layout policy provides a member template cell<Counter> that holds the counter X and the announce flag of a node and offers
+	 * the following operations, where a word is the value read from the cell:
+	 * 			+ load(): reads the word.
+	 * 			+ word(): the atomic that holds the counter, on which waiters wait (see backoff_traits).
+	 * 			+ count(word): the counter part of a word.
+	 * 			+ announced(word): whether the announce flag is set.
+	 * 			+ set_announce(word): sets the announce flag; word is updated to a value suitable for the next increment().
+	 * 			+ increment(word): a CAS that adds 1 to the counter; on failure word is updated with the current word.
+	 * 			+ decrement(word): a CAS that subtracts 1 from the counter and clears the announce flag if the counter drops to 0; on failure
+	 * 			  word is updated with the current word.
+	 *
+	 * The padded layouts are templates on the padding in bytes (basic_split_layout<Align> and basic_compact_layout<Align>), so the padding can
+	 * be chosen per SNZI object, for example basic_compact_layout<adjacent_line_padding> on parts with the adjacent-line prefetcher (see
+	 * cache_line.hpp). split_layout and compact_layout pad to CACHE_LINE_SIZE, which is chosen per build (see config.hpp).
+	 *
+	 * The member type update_path of a cell selects the algorithm of the nodes: cas_update for the cells above, whose counter is only
+	 * changed by CAS loops, and fetch_add_update for the cells of fetch_add_layout, which offer a different set of operations (see there).
+	 *
+	 * Every cell also offers reset(), which returns it to its initial state (counter 0 and no flag set) for the reset() of a quiescent tree.
+	 */
+
+	struct cas_update{}; //! The counter of the cell is changed by CAS loops that decide before they change it
+	struct fetch_add_update{}; //! The counter of the cell is changed by fetch_add and fetch_sub, which decide afterwards
+
+	/**
+	 * The original layout: X and announce are placed on separate cache lines (of Align bytes). A node spans two cache lines and an Arrive
+	 * operation that finds the counter 0 touches both of them.
+	 */
+	template<std::size_t Align>
+	struct basic_split_layout{
+		static_assert(Align && !(Align & (Align - 1)), "padding of a layout must be a power of 2");
+
+		template<typename Counter>
+		struct cell{
+			alignas(Align) std::atomic<Counter> X;
+			alignas(Align) std::atomic<bool> announce;
+
+			using update_path = cas_update;
+
+			cell(){
+				reset();
+			}
+
+			void reset(){
+				X.store(0, snzi_order::init);
+				announce.store(false, snzi_order::init);
+			}
+
+			Counter load() const{
+				return X.load(snzi_order::probe);
+			}
+
+			const std::atomic<Counter>& word() const{
+				return X;
+			}
+
+			static Counter count(Counter x){
+				return x;
+			}
+
+			bool announced(Counter) const{
+				return announce.load(snzi_order::hint);
+			}
+
+			void set_announce(Counter&){
+				announce.store(true, snzi_order::hint);
+			}
+
+			bool increment(Counter& oldx){
+				return X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure);
+			}
+
+			bool decrement(Counter& oldx){
+				if (oldx == 1){
+					announce.store(false, snzi_order::hint);
+				}
+				// use a strong version here to avoid the possibility of a spurious failure while oldx == 1
+				// that would lead to two stores to announce
+				return X.compare_exchange_strong(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure);
+			}
+		};
+	};
+
+	/**
+	 * A cell that keeps the announce flag in the most significant bit of the counter word, so the announce check and the counter CAS
+	 * touch the same cache line. The flag is cleared by the same CAS that takes the counter from 1 to 0. The cell is aligned to Align bytes.
+	 */
+	template<typename Counter, std::size_t Align>
+	struct announce_bit_cell{
+		static const Counter announce_bit = Counter(1) << (std::numeric_limits<Counter>::digits - 1);
+
+		alignas(Align) std::atomic<Counter> X;
+
+		using update_path = cas_update;
+
+		announce_bit_cell(){
+			reset();
+		}
+
+		void reset(){
+			X.store(0, snzi_order::init);
+		}
+
+		Counter load() const{
+			return X.load(snzi_order::probe);
+		}
+
+		const std::atomic<Counter>& word() const{
+			return X;
+		}
+
+		static Counter count(Counter x){
+			return x & ~announce_bit;
+		}
+
+		bool announced(Counter x) const{
+			return (x & announce_bit) != 0;
+		}
+
+		void set_announce(Counter& oldx){
+			oldx = X.fetch_or(announce_bit, snzi_order::hint) | announce_bit;
+		}
+
+		bool increment(Counter& oldx){
+			return X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure);
+		}
+
+		bool decrement(Counter& oldx){
+			return X.compare_exchange_weak(oldx, count(oldx) == 1 ? Counter(0) : oldx - 1, snzi_order::depart, snzi_order::cas_failure);
+		}
+	};
+
+	template<typename Counter, std::size_t Align>
+	const Counter announce_bit_cell<Counter, Align>::announce_bit;
+
+	/**
+	 * The announce flag is a bit of the counter word and every node occupies a single cache line (of Align bytes).
+	 */
+	template<std::size_t Align>
+	struct basic_compact_layout{
+		static_assert(Align && !(Align & (Align - 1)), "padding of a layout must be a power of 2");
+
+		template<typename Counter>
+		using cell = announce_bit_cell<Counter, Align>;
+	};
+
+	/**
+	 * A cell whose counter is changed by a single fetch_add or fetch_sub instead of a CAS loop, so arrivals and departures at a busy node
+	 * do not fail and retry against each other.
+	 *
+	 * The counter is kept biased: the word holds twice the counter, and its lowest bit, the settled bit, is set while the parent holds
+	 * the arrival of the node. An Arrive operation adds 2 and is done if the word it replaced was settled; otherwise it was among the
+	 * first arrivals since the counter was 0 and must make sure the parent holds an arrival before it returns. The arrival at the parent
+	 * is published by setting the settled bit with a CAS, which only the thread that arrived at the parent attempts, and it is withdrawn
+	 * only by the CAS that finds the word exactly settled with the counter 0, so a thread that adds 2 to a settled word can always rely on it.
+	 * A Depart operation subtracts 2 and only has to clear the settled bit, and depart from the parent, if it took the counter to 0.
+	 *
+	 * The bit is part of the low 32 bits of the word, so a change of it wakes the threads parked on the word (see parking.hpp). The
+	 * announce flag of the other layouts is implied: a word that is not settled with a counter above 1 has an Arrive in progress.
+	 *
+	 * The cell offers load(), word() and count() as the other cells, and:
+	 * 			+ fetch_increment(): adds 1 to the counter and returns the previous word.
+	 * 			+ fetch_decrement(): subtracts 1 from the counter and returns the previous word.
+	 * 			+ observe(): reads the word with acquire order, for a thread that may return on what it sees.
+	 * 			+ settled(word): whether the settled bit is set.
+	 * 			+ settle(word): a CAS that sets the settled bit; on failure word is updated with the current word.
+	 * 			+ unsettle(): a CAS that clears the settled bit if the counter is 0; returns whether it did.
+	 */
+	template<typename Counter, std::size_t Align>
+	struct biased_counter_cell{
+		static const Counter settled_bit = 1;
+		static const Counter unit = 2;
+
+		alignas(Align) std::atomic<Counter> X;
+
+		using update_path = fetch_add_update;
+
+		biased_counter_cell(){
+			reset();
+		}
+
+		void reset(){
+			X.store(0, snzi_order::init);
+		}
+
+		Counter load() const{
+			return X.load(snzi_order::probe);
+		}
+
+		Counter observe() const{
+			return X.load(snzi_order::observe);
+		}
+
+		const std::atomic<Counter>& word() const{
+			return X;
+		}
+
+		static Counter count(Counter x){
+			return x/unit;
+		}
+
+		static bool settled(Counter x){
+			return (x & settled_bit) != 0;
+		}
+
+		Counter fetch_increment(){
+			return X.fetch_add(unit, snzi_order::arrive);
+		}
+
+		Counter fetch_decrement(){
+			return X.fetch_sub(unit, snzi_order::depart);
+		}
+
+		bool settle(Counter& oldx){
+			return X.compare_exchange_weak(oldx, oldx | settled_bit, snzi_order::arrive, snzi_order::observe);
+		}
+
+		bool unsettle(){
+			Counter expected = settled_bit;
+			return X.compare_exchange_strong(expected, 0, snzi_order::depart, snzi_order::cas_failure);
+		}
+	};
+
+	template<typename Counter, std::size_t Align>
+	const Counter biased_counter_cell<Counter, Align>::settled_bit;
+
+	template<typename Counter, std::size_t Align>
+	const Counter biased_counter_cell<Counter, Align>::unit;
+
+	/**
+	 * Every node occupies a single cache line (of Align bytes) and its counter is changed by fetch_add and fetch_sub (see
+	 * biased_counter_cell).
+	 */
+	template<std::size_t Align>
+	struct basic_fetch_add_layout{
+		static_assert(Align && !(Align & (Align - 1)), "padding of a layout must be a power of 2");
+
+		template<typename Counter>
+		using cell = biased_counter_cell<Counter, Align>;
+	};
+
+	using split_layout = basic_split_layout<CACHE_LINE_SIZE>;
+	using compact_layout = basic_compact_layout<CACHE_LINE_SIZE>;
+	using fetch_add_layout = basic_fetch_add_layout<CACHE_LINE_SIZE>;
+
+	/**
+	 * The announce flag is a bit of the counter word and nodes are not padded, so several nodes share a cache line. This trades
+	 * false sharing for footprint and is meant for the interior levels of the tree, which see few operations by design.
+	 */
+	struct packed_layout{
+		template<typename Counter>
+		using cell = announce_bit_cell<Counter, alignof(std::atomic<Counter>)>;
+	};
+
+} // namespace concurrent
+
+#endif /* SNZI_LAYOUT_HPP_ */
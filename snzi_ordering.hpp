@@ -0,0 +1,79 @@
+#ifndef SNZI_ORDERING_HPP_
+#define SNZI_ORDERING_HPP_
+
+#include <atomic>
+
+namespace concurrent{
+
+	/**
+	 * The memory orders used by the SNZI operations.
+	 *
+	 * Ordering contract. The SNZI objects guarantee the following to their clients:
+	 * 			+ An Arrive operation is an acquire operation: the memory operations that the thread issues after Arrive returns are not
+	 * 			  reordered before it.
+	 * 			+ A Depart operation is a release operation: the memory operations that the thread issued before Depart are not reordered
+	 * 			  after it.
+	 * 			+ A Query operation is an acquire operation. If it returns false, every Depart operation whose matching Arrive it does not see
+	 * 			  happens-before the return of Query; in particular the memory operations issued between such an Arrive and its Depart are
+	 * 			  visible to the querier.
+	 * 			+ Arrive, Depart and Query are linearizable with respect to each other: all of them act on the root counter through
+	 * 			  read-modify-write operations or loads of a single location, whose modification order is total under any memory order.
+	 *
+	 * The SNZI objects do not order an Arrive operation before a later load of a different location by the same thread (store-load order).
+	 * Clients that combine a SNZI with another flag in a Dekker-style handshake, such as a reader that Arrives and then reads a writer flag while
+	 * the writer sets the flag and then Queries, must issue std::atomic_thread_fence(std::memory_order_seq_cst) between the two steps on
+	 * both sides, or build with -DSNZI_SEQ_CST_ORDERING.
+	 *
+	 * Why these orders are enough. The value of a node counter is changed only by read-modify-write operations, so every change of a node
+	 * continues the release sequence of all the earlier ones.
+	 * 			+ A Depart that takes a counter from 1 to 0 must carry the release of the Departs that preceded it on that node (and of the
+	 * 			  critical sections behind them) up to the parent, so the decrement of a node is acq_rel and the decrement of the root release.
+	 * 			+ An Arrive that takes a counter from 0 to 1 has already arrived at the parent. A thread that later finds the counter nonzero and
+	 * 			  returns without touching the parent relies on that arrival, so the increment of a node is acq_rel: release publishes the
+	 * 			  arrival at the parent to whoever reads the counter, acquire makes the Arrive an acquire operation. The root increment, which has no
+	 * 			  parent to publish, is acquire.
+	 * 			+ The first load of a counter and the value returned by a failed CAS are only guesses for the next CAS and are relaxed.
+	 * 			+ With fetch_add_layout an Arrive may find the counter nonzero before the node has arrived at its parent. It relies on the
+	 * 			  arrival at the parent only once it sees the settled bit, which is set by an acq_rel CAS, so the loads that look for the bit are
+	 * 			  acquire. The CAS that clears the bit after the counter dropped to 0 is a decrement.
+	 * 			+ The announce flag only decides whether an arriving thread waits before propagating; it never affects the counters, so it is
+	 * 			  relaxed.
+	 *
+	 * On x86 every read-modify-write is a locked instruction regardless of its order, so the savings there are the seq_cst stores of the
+	 * announce flag (xchg instead of mov) and the compiler's freedom to move the relaxed loads. Weakly-ordered targets also avoid the full fences
+	 * that seq_cst puts around every operation.
+	 *
+	 * Building with -DSNZI_SEQ_CST_ORDERING makes every order seq_cst, which is the behavior before the orders were relaxed; the benchmark
+	 * makefiles build both versions so the two can be compared.
+	 */
+	namespace snzi_order{
+
+#ifdef SNZI_SEQ_CST_ORDERING
+		constexpr std::memory_order probe = std::memory_order_seq_cst; //! Loads that only guess the value for the next CAS
+		constexpr std::memory_order cas_failure = std::memory_order_seq_cst; //! The load part of a failed CAS
+		constexpr std::memory_order arrive = std::memory_order_seq_cst; //! Increments of a node
+		constexpr std::memory_order depart = std::memory_order_seq_cst; //! Decrements of a node
+		constexpr std::memory_order root_arrive = std::memory_order_seq_cst; //! Increments of the root
+		constexpr std::memory_order root_depart = std::memory_order_seq_cst; //! Decrements of the root
+		constexpr std::memory_order query = std::memory_order_seq_cst; //! Loads of the root by Query
+		constexpr std::memory_order observe = std::memory_order_seq_cst; //! Loads whose value an Arrive operation returns on
+		constexpr std::memory_order hint = std::memory_order_seq_cst; //! Accesses to the announce flag
+		constexpr std::memory_order init = std::memory_order_seq_cst; //! Stores of the constructors
+#else
+		constexpr std::memory_order probe = std::memory_order_relaxed; //! Loads that only guess the value for the next CAS
+		constexpr std::memory_order cas_failure = std::memory_order_relaxed; //! The load part of a failed CAS
+		constexpr std::memory_order arrive = std::memory_order_acq_rel; //! Increments of a node
+		constexpr std::memory_order depart = std::memory_order_acq_rel; //! Decrements of a node
+		constexpr std::memory_order root_arrive = std::memory_order_acquire; //! Increments of the root
+		constexpr std::memory_order root_depart = std::memory_order_release; //! Decrements of the root
+		constexpr std::memory_order query = std::memory_order_acquire; //! Loads of the root by Query
+		constexpr std::memory_order observe = std::memory_order_acquire; //! Loads whose value an Arrive operation returns on
+		constexpr std::memory_order hint = std::memory_order_relaxed; //! Accesses to the announce flag
+		constexpr std::memory_order init = std::memory_order_relaxed; //! Stores of the constructors
+#endif
+
+	} // namespace snzi_order
+
+} // namespace concurrent
+
+#endif /* SNZI_ORDERING_HPP_ */
@@ -0,0 +1,174 @@
+/**
+ * This file sweeps the backoff policies of backoff.hpp on the full-contention SNZI, which backs off both in the announce wait of
+ * its nodes and between the failed CAS operations of its direct arrivals at the root.
+ *
+ * The workload is the visit of snzi_perf_eval_full_contention.cpp (Arrive, Depart, Query) on a tree with (K,H)=(2,1).
+ */
+#include <cstddef>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "snzi.hpp"
+#include "backoff.hpp"
+#include "parking.hpp"
+#include "affinity.hpp"
+#include "profile.hpp"
+
+// in seconds
+#define SECONDS (30)
+#define DURATION (SECONDS)
+
+const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
+const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
+
+// the shape of the tree
+const std::size_t K = 2;
+const std::size_t H = 1;
+
+template<typename Backoff>
+using snzi_type = concurrent::basic_full_contention_handling_snzi<concurrent::split_layout, concurrent::split_layout, Backoff>;
+
+/**
+ * Performs the experiment for a SNZI of type Snzi
+ */
+template<typename Snzi>
+void run_experiment_for_policy(const char* name, std::vector<double>& all_visits);
+
+int main(void){
+	const char* names[] = {"exponential", "none", "jittered", "proportional", "calibrated", "parking"};
+	const std::size_t num_policies = sizeof(names)/sizeof(names[0]);
+
+	std::vector<std::vector<double> > data;
+	data.resize(num_policies);
+
+	std::cout << "TSC ticks per ns: " << concurrent::backoff_detail::tsc_ticks_per_ns() << std::endl;
+
+	std::cout << "Starting the experiemnt" << std::endl;
+	run_experiment_for_policy<snzi_type<concurrent::exponential_backoff> >(names[0], data[0]);
+	run_experiment_for_policy<snzi_type<concurrent::no_backoff> >(names[1], data[1]);
+	run_experiment_for_policy<snzi_type<concurrent::jittered_exponential_backoff<> > >(names[2], data[2]);
+	run_experiment_for_policy<snzi_type<concurrent::proportional_backoff<> > >(names[3], data[3]);
+	run_experiment_for_policy<snzi_type<concurrent::calibrated_backoff<> > >(names[4], data[4]);
+	run_experiment_for_policy<snzi_type<concurrent::parking_backoff<> > >(names[5], data[5]);
+	std::cout << "Done" << std::endl;
+
+	std::cout << "Writing data to file" << std::endl;
+
+	/**
+	 * In the output file we will have this format:
+	 *
+	 * num_threads policy policy ... policy
+	 * 1	visits/ms	visits/ms	... visits/ms
+	 * 2	visits/ms	visits/ms	... visits/ms
+	 * ...
+	 */
+	std::ofstream out_file;
+
+	out_file.open("snzi-backoff.dat");
+
+	out_file << "# Performance evaluation of the backoff policies\n";
+	out_file << "# num_threads\t";
+
+	for (std::size_t i = 0; i < num_policies; ++i){
+		out_file << names[i] << "\t";
+	}
+	out_file << "\n";
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		out_file << num_threads[i] << "\t";
+
+		for (std::size_t j = 0; j < num_policies; ++j){
+			out_file << data[j][i] << "\t";
+		}
+
+		out_file << "\n";
+	}
+
+	out_file.close();
+
+	std::cout << "OK" << std::endl;
+
+	return (0);
+}
+
+template<typename Snzi>
+void run_experiment_for_policy(const char* name, std::vector<double>& all_visits){
+	std::cout << "Running experiment for backoff policy " << name << std::endl;
+
+	auto thread_job = [](Snzi& snzi_object, int id, std::atomic<bool>& flag, unsigned long& visits){
+		std::chrono::seconds duration{DURATION}; // how many seconds to run?
+
+		// when to end
+		std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now() + duration;
+
+		// wait until they tell us to start
+		while (!flag.load()){}
+
+		visits = 0;
+
+		typename Snzi::contention_status cont;
+
+		while (std::chrono::system_clock::now() < end_time){
+			// make a visit
+			snzi_object.Arrive(id, cont);
+			snzi_object.Depart(id, cont);
+			snzi_object.Query();
+			++visits;
+		}
+	};
+
+	std::atomic<bool> flag; // used to signal the threads when to start
+
+	concurrent::affinity aff_setter;
+	const unsigned int num_cores = std::thread::hardware_concurrency();
+
+	all_visits.resize(num_threads_count);
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		std::cout << "Clearing caches..." << std::endl;
+		profile::cache_wiper cw;
+		cw.clear_caches();
+		std::cout << "Done." << std::endl;
+
+		const std::size_t how_many_threads = num_threads[i];
+
+		Snzi snzi_object(K, H, how_many_threads);
+
+		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
+
+		flag = false;
+
+		std::vector<std::thread> threads;
+
+		std::vector<unsigned long> visits;
+		visits.resize(how_many_threads);
+
+		for (std::size_t j = 0; j < how_many_threads; ++j){
+			std::size_t id = j;
+
+			std::thread t = std::thread{thread_job, std::ref(snzi_object), id, std::ref(flag), std::ref(visits[j])};
+			std::thread::native_handle_type t_handle = t.native_handle();
+			threads.push_back(std::move(t));
+
+			aff_setter(id%num_cores, t_handle);
+		}
+
+		flag = true;
+
+		std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+
+		double sum_average_throughput = 0.0;
+		for (auto& num_visits : visits){
+			sum_average_throughput += ((double)num_visits/(double)(DURATION*1000));
+		}
+		all_visits[i] = sum_average_throughput/(double)how_many_threads;
+	}
+}
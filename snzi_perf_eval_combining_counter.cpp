@@ -0,0 +1,185 @@
+/**
+ * This file compares the throughput of the combining tree counter (see combining_counter.hpp) with a single std::atomic counter.
+ *
+ * Each thread repeatedly adds 1 to the counter with fetch_add and uses the returned value, as a ticket dispenser would. The total
+ * throughput of all the threads is reported for the atomic counter and for binary combining trees of height 1, 2 and 3, which have
+ * 2, 4 and 8 leaves.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "combining_counter.hpp"
+#include "config.hpp"
+#include "affinity.hpp"
+#include "profile.hpp"
+
+// in seconds
+#define SECONDS (10)
+#define DURATION (SECONDS)
+
+const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
+const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
+
+/**
+ * A single atomic counter with the interface of combining_counter
+ */
+class atomic_counter{
+public:
+	using value_type = std::uint64_t;
+
+	atomic_counter(std::size_t, std::size_t, std::size_t){
+		value.store(0);
+	}
+
+	value_type fetch_add(std::size_t, value_type v){
+		return value.fetch_add(v);
+	}
+
+private:
+	alignas(CACHE_LINE_SIZE) std::atomic<value_type> value;
+};
+
+/**
+ * Performs the experiment for a counter of type Counter on a binary tree of height H
+ */
+template<typename Counter>
+void run_experiment_for_counter(const char* name, std::size_t H, std::vector<double>& all_ops);
+
+int main(void){
+	const char* names[] = {"atomic", "combining-H1", "combining-H2", "combining-H3"};
+	const std::size_t num_counters = sizeof(names)/sizeof(names[0]);
+
+	std::vector<std::vector<double> > data;
+	data.resize(num_counters);
+
+	std::cout << "Starting the experiemnt" << std::endl;
+	run_experiment_for_counter<atomic_counter>(names[0], 0, data[0]);
+	run_experiment_for_counter<concurrent::combining_counter>(names[1], 1, data[1]);
+	run_experiment_for_counter<concurrent::combining_counter>(names[2], 2, data[2]);
+	run_experiment_for_counter<concurrent::combining_counter>(names[3], 3, data[3]);
+	std::cout << "Done" << std::endl;
+
+	std::cout << "Writing data to file" << std::endl;
+
+	/**
+	 * In the output file we will have this format:
+	 *
+	 * num_threads counter counter ... counter
+	 * 1	ops/ms	ops/ms	... ops/ms
+	 * 2	ops/ms	ops/ms	... ops/ms
+	 * ...
+	 */
+	std::ofstream out_file;
+
+	out_file.open("snzi-combining-counter.dat");
+
+	out_file << "# Performance evaluation of the exact counters (total of all threads)\n";
+	out_file << "# num_threads\t";
+
+	for (std::size_t i = 0; i < num_counters; ++i){
+		out_file << names[i] << "\t";
+	}
+	out_file << "\n";
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		out_file << num_threads[i] << "\t";
+
+		for (std::size_t j = 0; j < num_counters; ++j){
+			out_file << data[j][i] << "\t";
+		}
+
+		out_file << "\n";
+	}
+
+	out_file.close();
+
+	std::cout << "OK" << std::endl;
+
+	return (0);
+}
+
+template<typename Counter>
+void run_experiment_for_counter(const char* name, std::size_t H, std::vector<double>& all_ops){
+	std::cout << "Running experiment for counter " << name << std::endl;
+
+	auto thread_job = [](Counter& counter, int id, std::atomic<bool>& flag, unsigned long& ops){
+		std::chrono::seconds duration{DURATION}; // how many seconds to run?
+
+		// when to end
+		std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now() + duration;
+
+		// wait until they tell us to start
+		while (!flag.load()){}
+
+		ops = 0;
+		std::uint64_t last_ticket = 0;
+
+		while (std::chrono::system_clock::now() < end_time){
+			// take a ticket
+			last_ticket ^= counter.fetch_add(id, 1);
+			++ops;
+		}
+
+		// so that the tickets are not optimized away
+		if (last_ticket == static_cast<std::uint64_t>(-1)){
+			std::cout << last_ticket << std::endl;
+		}
+	};
+
+	std::atomic<bool> flag; // used to signal the threads when to start
+
+	concurrent::affinity aff_setter;
+	const unsigned int num_cores = std::thread::hardware_concurrency();
+
+	all_ops.resize(num_threads_count);
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		std::cout << "Clearing caches..." << std::endl;
+		profile::cache_wiper cw;
+		cw.clear_caches();
+		std::cout << "Done." << std::endl;
+
+		const std::size_t how_many_threads = num_threads[i];
+
+		Counter counter(2, H, how_many_threads);
+
+		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
+
+		flag = false;
+
+		std::vector<std::thread> threads;
+
+		std::vector<unsigned long> ops;
+		ops.resize(how_many_threads);
+
+		for (std::size_t j = 0; j < how_many_threads; ++j){
+			std::size_t id = j;
+
+			std::thread t = std::thread{thread_job, std::ref(counter), id, std::ref(flag), std::ref(ops[j])};
+			std::thread::native_handle_type t_handle = t.native_handle();
+			threads.push_back(std::move(t));
+
+			aff_setter(id%num_cores, t_handle);
+		}
+
+		flag = true;
+
+		std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+
+		double total_throughput = 0.0;
+		for (auto& num_ops : ops){
+			total_throughput += ((double)num_ops/(double)(DURATION*1000));
+		}
+		all_ops[i] = total_throughput;
+	}
+}
@@ -22,6 +22,14 @@
 #define MINUTES (3)
 #define DURATION (MINUTES*60)
 
+// build with -DSNZI_FETCH_ADD_NODES to measure the fetch_add path of the nodes (see fetch_add_layout in snzi_layout.hpp)
+// instead of the CAS loops, and with -DSNZI_ROOT_COMBINING to combine the direct operations at the root (see set_root_combining())
+#ifdef SNZI_FETCH_ADD_NODES
+using snzi_type = concurrent::basic_full_contention_handling_snzi<concurrent::fetch_add_layout>;
+#else
+using snzi_type = concurrent::full_contention_handling_snzi;
+#endif
+
 const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
 const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
 	
@@ -77,7 +85,17 @@ int main(void){
 	
 	std::ofstream out_file;
 	
-	out_file.open("snzi-full-contention.dat");
+	std::string out_file_name = "snzi-full-contention";
+#ifdef SNZI_FETCH_ADD_NODES
+	out_file_name += "-fetch-add";
+#endif
+#ifdef SNZI_ROOT_COMBINING
+	out_file_name += "-combining";
+#endif
+#ifdef SNZI_SEQ_CST_ORDERING
+	out_file_name += "-seq-cst";
+#endif
+	out_file.open(out_file_name + ".dat");
 	
 	out_file << "# Performance evaluation of snzi object\n";
 	out_file << "# num_threads\t";
@@ -117,7 +135,7 @@ int main(void){
 void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>& all_visits){
 	std::cout << "Running experiment for parameters (K,H) = (" << K << "," << H << ")" << std::endl;
 
-	auto thread_job = [](concurrent::full_contention_handling_snzi& snzi_object, int id, std::atomic<bool>& flag, unsigned long& visits){
+	auto thread_job = [](snzi_type& snzi_object, int id, std::atomic<bool>& flag, unsigned long& visits){
 		std::chrono::seconds duration{DURATION}; // how many seconds to run?
 				
 		// when to end
@@ -128,7 +146,7 @@ void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>&
 		
 		visits = 0;
 		
-		concurrent::full_contention_handling_snzi::contention_status cont;
+		snzi_type::contention_status cont;
 
 		while (std::chrono::system_clock::now() < end_time){
 			// make a visit
@@ -157,7 +175,10 @@ void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>&
 		const std::size_t how_many_threads = num_threads[i];
 		
 		std::cout << "Constructing the SNZI object" << std::endl;
-		concurrent::full_contention_handling_snzi snzi_object(K,H, how_many_threads); // the snzi for this experiement
+		snzi_type snzi_object(K,H, how_many_threads); // the snzi for this experiement
+#ifdef SNZI_ROOT_COMBINING
+		snzi_object.set_root_combining(true);
+#endif
 		std::cout << "Done" << std::endl;
 		
 		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
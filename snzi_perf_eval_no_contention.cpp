@@ -77,7 +77,11 @@ int main(void){
 	
 	std::ofstream out_file;
 	
+#ifdef SNZI_SEQ_CST_ORDERING
+	out_file.open("snzi-no-contention-seq-cst.dat");
+#else
 	out_file.open("snzi-no-contention.dat");
+#endif
 	
 	out_file << "# Performance evaluation of snzi object\n";
 	out_file << "# num_threads\t";
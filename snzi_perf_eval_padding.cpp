@@ -0,0 +1,173 @@
+/**
+ * This file evaluates the effect of the padding of the SNZI nodes on the throughput of sibling leaves.
+ *
+ * Every thread uses its own leaf of a tree with one level of 8 leaves, so the leaves of consecutive threads are neighbors in memory.
+ * Before the measurement each thread arrives once at its leaf and stays, so the counter of its leaf never returns to 0 and the Arrive
+ * and Depart operations that are measured never propagate to the root. The only memory traffic between the threads is then the false
+ * sharing between neighboring leaves, which depends only on the padding: with 64-byte padding the adjacent-line prefetcher of Intel parts
+ * still pulls the neighbor's line, with 128-byte padding it does not.
+ */
+#include <cstddef>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "snzi.hpp"
+#include "cache_line.hpp"
+#include "affinity.hpp"
+#include "profile.hpp"
+
+// in seconds
+#define SECONDS (30)
+#define DURATION (SECONDS)
+
+const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
+const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
+
+// one leaf per thread
+const std::size_t num_leaves = 8;
+
+/**
+ * Performs the experiment for a SNZI of type Snzi
+ */
+template<typename Snzi>
+void run_experiment_for_layout(const char* name, std::vector<double>& all_visits);
+
+int main(void){
+	std::cout << "CACHE_LINE_SIZE for this build: " << CACHE_LINE_SIZE << " bytes" << std::endl;
+
+	const char* names[] = {"split-64", "compact-64", "compact-128", "compact-256"};
+	const std::size_t num_layouts = sizeof(names)/sizeof(names[0]);
+
+	std::vector<std::vector<double> > data;
+	data.resize(num_layouts);
+
+	std::cout << "Starting the experiemnt" << std::endl;
+	run_experiment_for_layout<concurrent::basic_semi_contention_handling_snzi<concurrent::basic_split_layout<concurrent::line_padding> > >(names[0], data[0]);
+	run_experiment_for_layout<concurrent::basic_semi_contention_handling_snzi<concurrent::basic_compact_layout<concurrent::line_padding> > >(names[1], data[1]);
+	run_experiment_for_layout<concurrent::basic_semi_contention_handling_snzi<concurrent::basic_compact_layout<concurrent::adjacent_line_padding> > >(names[2], data[2]);
+	run_experiment_for_layout<concurrent::basic_semi_contention_handling_snzi<concurrent::basic_compact_layout<concurrent::sector_padding> > >(names[3], data[3]);
+	std::cout << "Done" << std::endl;
+
+	std::cout << "Writing data to file" << std::endl;
+
+	/**
+	 * In the output file we will have this format:
+	 *
+	 * num_threads layout layout ... layout
+	 * 1	visits/ms	visits/ms	... visits/ms
+	 * 2	visits/ms	visits/ms	... visits/ms
+	 * ...
+	 */
+	std::ofstream out_file;
+
+	out_file.open("snzi-padding.dat");
+
+	out_file << "# Performance evaluation of the padding of sibling leaves\n";
+	out_file << "# num_threads\t";
+
+	for (std::size_t i = 0; i < num_layouts; ++i){
+		out_file << names[i] << "\t";
+	}
+	out_file << "\n";
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		out_file << num_threads[i] << "\t";
+
+		for (std::size_t j = 0; j < num_layouts; ++j){
+			out_file << data[j][i] << "\t";
+		}
+
+		out_file << "\n";
+	}
+
+	out_file.close();
+
+	std::cout << "OK" << std::endl;
+
+	return (0);
+}
+
+template<typename Snzi>
+void run_experiment_for_layout(const char* name, std::vector<double>& all_visits){
+	std::cout << "Running experiment for layout " << name << std::endl;
+
+	auto thread_job = [](Snzi& snzi_object, int id, std::atomic<bool>& flag, unsigned long& visits){
+		std::chrono::seconds duration{DURATION}; // how many seconds to run?
+
+		// when to end
+		std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now() + duration;
+
+		// stay at the leaf so that the measured operations do not propagate
+		snzi_object.Arrive(id);
+
+		// wait until they tell us to start
+		while (!flag.load()){}
+
+		visits = 0;
+
+		while (std::chrono::system_clock::now() < end_time){
+			// make a visit
+			snzi_object.Arrive(id);
+			snzi_object.Depart(id);
+			++visits;
+		}
+
+		snzi_object.Depart(id);
+	};
+
+	std::atomic<bool> flag; // used to signal the threads when to start
+
+	concurrent::affinity aff_setter;
+	const unsigned int num_cores = std::thread::hardware_concurrency();
+
+	all_visits.resize(num_threads_count);
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		std::cout << "Clearing caches..." << std::endl;
+		profile::cache_wiper cw;
+		cw.clear_caches();
+		std::cout << "Done." << std::endl;
+
+		const std::size_t how_many_threads = num_threads[i];
+
+		// num_leaves threads, so that thread j uses leaf j
+		Snzi snzi_object(num_leaves, 1, num_leaves);
+
+		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
+
+		flag = false;
+
+		std::vector<std::thread> threads;
+
+		std::vector<unsigned long> visits;
+		visits.resize(how_many_threads);
+
+		for (std::size_t j = 0; j < how_many_threads; ++j){
+			std::size_t id = j;
+
+			std::thread t = std::thread{thread_job, std::ref(snzi_object), id, std::ref(flag), std::ref(visits[j])};
+			std::thread::native_handle_type t_handle = t.native_handle();
+			threads.push_back(std::move(t));
+
+			aff_setter(id%num_cores, t_handle);
+		}
+
+		flag = true;
+
+		std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+
+		double sum_average_throughput = 0.0;
+		for (auto& num_visits : visits){
+			sum_average_throughput += ((double)num_visits/(double)(DURATION*1000));
+		}
+		all_visits[i] = sum_average_throughput/(double)how_many_threads;
+	}
+}
@@ -0,0 +1,194 @@
+/**
+ * This file evaluates the process-shared SNZI (see process_shared_snzi.hpp) with processes instead of threads.
+ *
+ * The SNZI object and the results are placed in an anonymous shared mapping that is created before the worker processes are forked, so
+ * every process sees the same indicator. Each process makes visits (Arrive, Depart, Query) as the threads of the other benchmarks do.
+ */
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "process_shared_snzi.hpp"
+#include "affinity.hpp"
+#include "profile.hpp"
+
+// in seconds
+#define SECONDS (30)
+#define DURATION (SECONDS)
+
+const std::size_t num_processes[] = {1,2,3,4,5,6,7,8};
+const std::size_t num_processes_count = sizeof(num_processes)/sizeof(num_processes[0]);
+
+/**
+ * The part of the shared mapping that is not the SNZI object.
+ */
+struct shared_state{
+	std::atomic<bool> flag; // used to signal the processes when to start
+	unsigned long visits[8]; // the visits of each process
+};
+
+/**
+ * Performs the experiment for a SNZI with parameters K,H
+ */
+void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>& all_visits);
+
+int main(void){
+	std::size_t K[] = {2,2,2,4};
+	std::size_t H[] = {0,1,2,1};
+	const std::size_t num_parameters = sizeof(K)/sizeof(K[0]);
+
+	std::vector<std::vector<double> > data;
+	data.resize(num_parameters);
+
+	std::cout << "Starting the experiemnt" << std::endl;
+	for (std::size_t i = 0; i < num_parameters; ++i){
+		run_experiment_for_tree(K[i], H[i], data[i]);
+	}
+	std::cout << "Done" << std::endl;
+
+	std::cout << "Writing data to file" << std::endl;
+
+	/**
+	 * In the output file we will have this format:
+	 *
+	 * num_processes (K,H)=(?,?) (K,H)=(?,?) ... (K,H)=(?,?)
+	 * 1	visits/ms	visits/ms	... visits/ms
+	 * 2	visits/ms	visits/ms	... visits/ms
+	 * ...
+	 */
+	std::ofstream out_file;
+
+	out_file.open("snzi-process-shared.dat");
+
+	out_file << "# Performance evaluation of the process-shared snzi object\n";
+	out_file << "# num_processes\t";
+
+	for (std::size_t i = 0; i < num_parameters; ++i){
+		out_file << "(K,H)=(" << K[i] << "," << H[i] << ")" << "\t";
+	}
+	out_file << "\n";
+
+	for (std::size_t i = 0; i < num_processes_count; ++i){
+		out_file << num_processes[i] << "\t";
+
+		for (std::size_t j = 0; j < num_parameters; ++j){
+			out_file << data[j][i] << "\t";
+		}
+
+		out_file << "\n";
+	}
+
+	out_file.close();
+
+	std::cout << "OK" << std::endl;
+
+	return (0);
+}
+
+void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>& all_visits){
+	std::cout << "Running experiment for parameters (K,H) = (" << K << "," << H << ")" << std::endl;
+
+	auto process_job = [](concurrent::process_shared_snzi& snzi_object, int id, shared_state& state){
+		std::chrono::seconds duration{DURATION}; // how many seconds to run?
+
+		// when to end
+		std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now() + duration;
+
+		// wait until they tell us to start
+		while (!state.flag.load()){}
+
+		unsigned long visits = 0;
+
+		while (std::chrono::system_clock::now() < end_time){
+			// make a visit
+			snzi_object.Arrive(id);
+			snzi_object.Depart(id);
+			snzi_object.Query();
+			++visits;
+		}
+
+		state.visits[id] = visits;
+	};
+
+	concurrent::affinity aff_setter;
+	const unsigned int num_cores = std::thread::hardware_concurrency();
+
+	std::cout << "num_cores = " << num_cores << std::endl;
+
+	all_visits.resize(num_processes_count);
+
+	// the shared state is placed after the SNZI object, on its own cache line
+	const std::size_t snzi_size = concurrent::process_shared_snzi::required_size(K, H);
+	const std::size_t state_offset = (snzi_size + CACHE_LINE_SIZE - 1)/CACHE_LINE_SIZE*CACHE_LINE_SIZE;
+	const std::size_t region_size = state_offset + sizeof(shared_state);
+
+	for (std::size_t i = 0; i < num_processes_count; ++i){
+		std::cout << "Clearing caches..." << std::endl;
+		profile::cache_wiper cw;
+		cw.clear_caches();
+		std::cout << "Done." << std::endl;
+
+		const std::size_t how_many_processes = num_processes[i];
+
+		void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (region == MAP_FAILED){
+			std::cerr << "mmap() failed" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		std::cout << "Constructing the SNZI object" << std::endl;
+		concurrent::process_shared_snzi* snzi_object = concurrent::process_shared_snzi::create(region, region_size, K, H, how_many_processes);
+		shared_state* state = new (static_cast<char*>(region) + state_offset) shared_state;
+		state->flag = false;
+		std::cout << "Done" << std::endl;
+
+		std::cout << "Running for " << how_many_processes << " processes" << std::endl;
+
+		std::vector<pid_t> children;
+
+		for (std::size_t j = 0; j < how_many_processes; ++j){
+			const int id = static_cast<int>(j);
+
+			pid_t pid = fork();
+			if (pid < 0){
+				std::cerr << "fork() failed" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			if (!pid){
+				aff_setter(id%num_cores, pthread_self());
+				process_job(*concurrent::process_shared_snzi::attach(region), id, *state);
+				_exit(0);
+			}
+			children.push_back(pid);
+		}
+
+		state->flag = true;
+
+		for (pid_t pid : children){
+			waitpid(pid, nullptr, 0);
+		}
+
+		double sum_average_throughput = 0.0;
+		for (std::size_t j = 0; j < how_many_processes; ++j){
+			sum_average_throughput += ((double)state->visits[j]/(double)(DURATION*1000));
+		}
+		all_visits[i] = sum_average_throughput/(double)how_many_processes;
+
+		if (snzi_object->Query()){
+			std::cerr << "the SNZI object is not zero after all the processes departed" << std::endl;
+		}
+
+		munmap(region, region_size);
+	}
+}
@@ -22,6 +22,9 @@
 #define MINUTES (3)
 #define DURATION (MINUTES*60)
 
+// build with -DSNZI_DEPARTURE_HYSTERESIS to let the nodes hold their arrivals at their parents for up to 10 microseconds after they go
+// to 0 (see set_departure_hysteresis())
+
 const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
 const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
 	
@@ -77,7 +80,14 @@ int main(void){
 	
 	std::ofstream out_file;
 	
-	out_file.open("snzi-semi-contention.dat");
+	std::string out_file_name = "snzi-semi-contention";
+#ifdef SNZI_DEPARTURE_HYSTERESIS
+	out_file_name += "-hysteresis";
+#endif
+#ifdef SNZI_SEQ_CST_ORDERING
+	out_file_name += "-seq-cst";
+#endif
+	out_file.open(out_file_name + ".dat");
 	
 	out_file << "# Performance evaluation of snzi object\n";
 	out_file << "# num_threads\t";
@@ -156,6 +166,9 @@ void run_experiment_for_tree(std::size_t K, std::size_t H, std::vector<double>&
 		
 		std::cout << "Constructing the SNZI object" << std::endl;
 		concurrent::semi_contention_handling_snzi snzi_object(K,H, how_many_threads); // the snzi for this experiement
+#ifdef SNZI_DEPARTURE_HYSTERESIS
+		snzi_object.set_departure_hysteresis(concurrent::departure_hysteresis(10000));
+#endif
 		std::cout << "Done" << std::endl;
 		
 		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
@@ -0,0 +1,206 @@
+/**
+ * This file compares the tail latency of the wait-free SNZI (see wait_free_snzi.hpp) with the lock-free ones of snzi.hpp.
+ *
+ * Each thread repeatedly makes an Arrive and a Depart operation on a tree with (K,H)=(2,1) and records the time of the pair, measured
+ * with the time stamp counter, in a histogram. The 99th and 99.99th percentiles of all the threads are reported in nanoseconds.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "snzi.hpp"
+#include "wait_free_snzi.hpp"
+#include "backoff.hpp"
+#include "affinity.hpp"
+#include "profile.hpp"
+
+// in seconds
+#define SECONDS (10)
+#define DURATION (SECONDS)
+
+const std::size_t num_threads[] = {1,2,3,4,5,6,7,8};
+const std::size_t num_threads_count = sizeof(num_threads)/sizeof(num_threads[0]);
+
+// the shape of the tree
+const std::size_t K = 2;
+const std::size_t H = 1;
+
+// the histogram has buckets of bucket_ticks ticks; the last one holds every longer pair
+const std::uint64_t bucket_ticks = 16;
+const std::size_t num_buckets = 1 << 16;
+
+/**
+ * The percentiles of the latency of a pair, in nanoseconds
+ */
+struct latency{
+	double p99;
+	double p9999;
+};
+
+/**
+ * Performs the experiment for a SNZI of type Snzi
+ */
+template<typename Snzi>
+void run_experiment_for_variant(const char* name, std::vector<latency>& all_latencies);
+
+int main(void){
+	const char* names[] = {"no-contention", "semi-contention", "semi-contention-fetch-add", "wait-free"};
+	const std::size_t num_variants = sizeof(names)/sizeof(names[0]);
+
+	std::vector<std::vector<latency> > data;
+	data.resize(num_variants);
+
+	std::cout << "TSC ticks per ns: " << concurrent::backoff_detail::tsc_ticks_per_ns() << std::endl;
+
+	std::cout << "Starting the experiemnt" << std::endl;
+	run_experiment_for_variant<concurrent::no_contention_handling_snzi>(names[0], data[0]);
+	run_experiment_for_variant<concurrent::semi_contention_handling_snzi>(names[1], data[1]);
+	run_experiment_for_variant<concurrent::basic_semi_contention_handling_snzi<concurrent::fetch_add_layout> >(names[2], data[2]);
+	run_experiment_for_variant<concurrent::wait_free_snzi>(names[3], data[3]);
+	std::cout << "Done" << std::endl;
+
+	std::cout << "Writing data to file" << std::endl;
+
+	/**
+	 * In the output file we will have this format:
+	 *
+	 * num_threads variant:p99 variant:p99.99 ... variant:p99 variant:p99.99
+	 * 1	ns	ns	... ns	ns
+	 * 2	ns	ns	... ns	ns
+	 * ...
+	 */
+	std::ofstream out_file;
+
+	out_file.open("snzi-tail-latency.dat");
+
+	out_file << "# Tail latency of an Arrive and Depart pair\n";
+	out_file << "# num_threads\t";
+
+	for (std::size_t i = 0; i < num_variants; ++i){
+		out_file << names[i] << ":p99\t" << names[i] << ":p99.99\t";
+	}
+	out_file << "\n";
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		out_file << num_threads[i] << "\t";
+
+		for (std::size_t j = 0; j < num_variants; ++j){
+			out_file << data[j][i].p99 << "\t" << data[j][i].p9999 << "\t";
+		}
+
+		out_file << "\n";
+	}
+
+	out_file.close();
+
+	std::cout << "OK" << std::endl;
+
+	return (0);
+}
+
+/**
+ * Returns the latency, in nanoseconds, below which the given fraction of the pairs of histogram fall.
+ */
+double percentile(const std::vector<unsigned long>& histogram, double fraction){
+	unsigned long total = 0;
+	for (unsigned long count : histogram){
+		total += count;
+	}
+
+	const double rank = fraction*(double)total;
+	unsigned long seen = 0;
+	std::size_t bucket = 0;
+	for (; bucket < histogram.size(); ++bucket){
+		seen += histogram[bucket];
+		if ((double)seen >= rank){
+			break;
+		}
+	}
+
+	return (double)((bucket + 1)*bucket_ticks)/concurrent::backoff_detail::tsc_ticks_per_ns();
+}
+
+template<typename Snzi>
+void run_experiment_for_variant(const char* name, std::vector<latency>& all_latencies){
+	std::cout << "Running experiment for variant " << name << std::endl;
+
+	auto thread_job = [](Snzi& snzi_object, int id, std::atomic<bool>& flag, std::vector<unsigned long>& histogram){
+		std::chrono::seconds duration{DURATION}; // how many seconds to run?
+
+		// when to end
+		std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now() + duration;
+
+		// wait until they tell us to start
+		while (!flag.load()){}
+
+		while (std::chrono::system_clock::now() < end_time){
+			// make a visit and time it
+			const std::uint64_t start = concurrent::backoff_detail::rdtsc();
+			snzi_object.Arrive(id);
+			snzi_object.Depart(id);
+			const std::uint64_t ticks = concurrent::backoff_detail::rdtsc() - start;
+
+			++histogram[std::min<std::uint64_t>(ticks/bucket_ticks, num_buckets - 1)];
+		}
+	};
+
+	std::atomic<bool> flag; // used to signal the threads when to start
+
+	concurrent::affinity aff_setter;
+	const unsigned int num_cores = std::thread::hardware_concurrency();
+
+	all_latencies.resize(num_threads_count);
+
+	for (std::size_t i = 0; i < num_threads_count; ++i){
+		std::cout << "Clearing caches..." << std::endl;
+		profile::cache_wiper cw;
+		cw.clear_caches();
+		std::cout << "Done." << std::endl;
+
+		const std::size_t how_many_threads = num_threads[i];
+
+		Snzi snzi_object(K, H, how_many_threads);
+
+		std::cout << "Running for " << how_many_threads << " threads" << std::endl;
+
+		flag = false;
+
+		std::vector<std::thread> threads;
+
+		std::vector<std::vector<unsigned long> > histograms;
+		histograms.resize(how_many_threads, std::vector<unsigned long>(num_buckets, 0));
+
+		for (std::size_t j = 0; j < how_many_threads; ++j){
+			std::size_t id = j;
+
+			std::thread t = std::thread{thread_job, std::ref(snzi_object), id, std::ref(flag), std::ref(histograms[j])};
+			std::thread::native_handle_type t_handle = t.native_handle();
+			threads.push_back(std::move(t));
+
+			aff_setter(id%num_cores, t_handle);
+		}
+
+		flag = true;
+
+		std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+
+		std::vector<unsigned long> histogram(num_buckets, 0);
+		for (auto& h : histograms){
+			for (std::size_t b = 0; b < num_buckets; ++b){
+				histogram[b] += h[b];
+			}
+		}
+
+		all_latencies[i].p99 = percentile(histogram, 0.99);
+		all_latencies[i].p9999 = percentile(histogram, 0.9999);
+	}
+}
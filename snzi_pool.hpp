@@ -0,0 +1,163 @@
+#ifndef SNZI_POOL_HPP_
+#define SNZI_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "snzi_arena.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class snzi_pool keeps SNZI objects of type Snzi for reuse, so that short-lived indicators (one per request, for example) cost no
+	 * allocator calls and no page faults once the pool is warm. The objects are kept on shelves, one per shape (K,H,T): acquire() takes
+	 * an object of the requested shape from its shelf, or constructs one if the shelf is empty, and the returned pointer puts the object
+	 * back on its shelf, after calling reset() on it (see snzi.hpp), when it is destroyed. An object must therefore be quiescent when
+	 * its pointer is destroyed.
+	 *
+	 * reserve() constructs objects ahead of time. The pool and the threads that use it may run concurrently; each shelf has its own lock,
+	 * which is held only to push or pop a pointer, and the lock of the pool is only taken to find a shelf. A thread that creates many
+	 * indicators of one shape can look its shelf up once with get_shelf() and acquire from it directly.
+	 *
+	 * Snzi must be one of the classes of snzi.hpp, which are constructible from (K,H,T,arena) and offer reset(). The objects are constructed
+	 * with the arena given to the pool, if any. The pool must outlive the objects that it hands out.
+	 */
+	template<typename Snzi>
+	class snzi_pool{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+
+		class shelf;
+
+		/**
+		 * Puts an object back on its shelf.
+		 */
+		struct releaser{
+			shelf* owner{nullptr}; //! The shelf of the object
+
+			void operator()(Snzi* snzi_object) const{
+				owner->release(snzi_object);
+			}
+		};
+
+		using pointer = std::unique_ptr<Snzi, releaser>; //! An object of the pool, which returns to its shelf when destroyed
+
+		/**
+		 * The objects of one shape.
+		 */
+		class shelf{
+		public:
+			shelf(size_type K, size_type H, size_type T, snzi_arena* arena) : K(K), H(H), T(T), arena(arena){}
+
+			shelf(const shelf&) = delete;
+			shelf& operator=(const shelf&) = delete;
+
+			/**
+			 * \return An object of the shape of this shelf, in its initial state.
+			 * \throws invalid_argument If the SNZI objects reject the shape.
+			 */
+			pointer acquire(){
+				releaser r;
+				r.owner = this;
+
+				{
+					std::lock_guard<std::mutex> guard(objects_lock);
+					if (!objects.empty()){
+						Snzi* snzi_object = objects.back().release();
+						objects.pop_back();
+						return pointer(snzi_object, r);
+					}
+				}
+
+				return pointer(new Snzi(K, H, T, arena), r);
+			}
+
+			/**
+			 * Constructs objects until the shelf holds at least count of them.
+			 */
+			void reserve(size_type count){
+				std::lock_guard<std::mutex> guard(objects_lock);
+				objects.reserve(count);
+				while (objects.size() < count){
+					objects.emplace_back(new Snzi(K, H, T, arena));
+				}
+			}
+
+			/**
+			 * \return The number of objects on the shelf.
+			 */
+			size_type size() const{
+				std::lock_guard<std::mutex> guard(objects_lock);
+				return objects.size();
+			}
+
+		private:
+			friend struct releaser;
+
+			size_type K; //! The arity of the trees of the shelf
+			size_type H; //! The height of the trees of the shelf
+			size_type T; //! The number of threads of the objects of the shelf
+			snzi_arena* arena; //! The arena of the nodes, or nullptr for the heap
+			std::vector<std::unique_ptr<Snzi> > objects; //! The objects that are not in use
+			mutable std::mutex objects_lock; //! Protects objects
+
+			void release(Snzi* snzi_object){
+				std::unique_ptr<Snzi> owned(snzi_object);
+				owned->reset();
+
+				std::lock_guard<std::mutex> guard(objects_lock);
+				objects.push_back(std::move(owned));
+			}
+		};
+
+		/**
+		 * Constructs an empty pool whose objects are constructed with the given arena (see snzi_arena.hpp), or on the heap if arena is
+		 * nullptr. The arena must outlive the pool.
+		 */
+		explicit snzi_pool(snzi_arena* arena = nullptr) : arena(arena){}
+
+		snzi_pool(const snzi_pool&) = delete;
+		snzi_pool& operator=(const snzi_pool&) = delete;
+
+		/**
+		 * \return The shelf of the objects with the parameters K, H and T, which is created if there is none. It lives as long as the pool.
+		 */
+		shelf& get_shelf(size_type K, size_type H, size_type T){
+			std::lock_guard<std::mutex> guard(shelves_lock);
+
+			std::unique_ptr<shelf>& s = shelves[std::make_tuple(K, H, T)];
+			if (!s){
+				s.reset(new shelf(K, H, T, arena));
+			}
+			return *s;
+		}
+
+		/**
+		 * \return An object with the parameters K, H and T, in its initial state.
+		 * \throws invalid_argument If the SNZI objects reject the parameters.
+		 */
+		pointer acquire(size_type K, size_type H, size_type T){
+			return get_shelf(K, H, T).acquire();
+		}
+
+		/**
+		 * Constructs objects with the parameters K, H and T until their shelf holds at least count of them.
+		 */
+		void reserve(size_type K, size_type H, size_type T, size_type count){
+			get_shelf(K, H, T).reserve(count);
+		}
+
+	private:
+		using shape_key = std::tuple<size_type, size_type, size_type>; //! (K,H,T)
+
+		snzi_arena* arena; //! The arena of the nodes, or nullptr for the heap
+		std::map<shape_key, std::unique_ptr<shelf> > shelves; //! The shelves by shape
+		std::mutex shelves_lock; //! Protects shelves
+	};
+
+} // namespace concurrent
+
+#endif /* SNZI_POOL_HPP_ */
@@ -0,0 +1,201 @@
+#ifndef STATIC_SNZI_HPP_
+#define STATIC_SNZI_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <type_traits>
+#include "arrival_token.hpp"
+#include "config.hpp"
+#include "snzi_ordering.hpp"
+
+namespace concurrent{
+
+	namespace static_snzi_detail{
+
+		/**
+		 * \return b raised to the power of e.
+		 */
+		constexpr std::size_t pow_int(std::size_t b, std::size_t e){
+			return e ? b*pow_int(b, e - 1) : 1;
+		}
+
+		/**
+		 * \return The number of nodes in a perfect K-ary tree of height H.
+		 */
+		constexpr std::size_t nodes_count(std::size_t K, std::size_t H){
+			return (pow_int(K, H + 1) - 1)/(K - 1);
+		}
+
+		/**
+		 * \return The number of leaves in a perfect K-ary tree of height H.
+		 */
+		constexpr std::size_t leaves_count(std::size_t K, std::size_t H){
+			return pow_int(K, H);
+		}
+
+		/**
+		 * \return The number of threads assigned to each leaf when T threads share L leaves (at least 1).
+		 */
+		constexpr std::size_t threads_per_leaf(std::size_t T, std::size_t L){
+			return T > L ? (T + L - 1)/L : 1;
+		}
+
+	} // namespace static_snzi_detail
+
+	/**
+	 * Class static_snzi implements the SNZI object of no_contention_handling_snzi for a shape known at compile time: a perfect K-ary tree
+	 * of height H used by at most T threads.
+	 *
+	 * All the sizes (number of nodes, number of leaves, threads per leaf) are constant expressions and the nodes are stored inside the object
+	 * in a std::array, so a static_snzi needs no allocation and can be placed inline in the object it guards. Construction is constexpr, so a
+	 * static_snzi with static storage duration is constant-initialized.
+	 *
+	 * The parent of a node and the leaf of a thread are computed from compile-time constants. Moreover, the Arrive and Depart operations of
+	 * each level are separate instantiations (the level is a template argument), so the propagation path towards the root is unrolled by the
+	 * compiler and the operation on the root is a direct call.
+	 *
+	 * The assignment of threads to leaves is the same as in snzi.hpp.
+	 */
+	template<std::size_t K, std::size_t H, std::size_t T>
+	class static_snzi{
+		static_assert(K >= 2, "K parameter of static_snzi must be >= 2");
+
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+
+		static constexpr size_type arity = K; //! The arity of the SNZI tree
+		static constexpr size_type height = H; //! The height of the SNZI tree
+		static constexpr size_type total_threads = T; //! Number of threads to use this SNZI object
+		static constexpr size_type total_nodes = static_snzi_detail::nodes_count(K, H); //! Total number on nodes in the SNZI tree
+		static constexpr size_type total_leaf_nodes = static_snzi_detail::leaves_count(K, H); //! Number of leaf nodes in the SNZI tree
+		static constexpr size_type threads_per_leaf = static_snzi_detail::threads_per_leaf(T, total_leaf_nodes); //! The range of threads allocated to each leaf node
+
+	private:
+		using counter_type = std::uint64_t; //! Type used for the counter at each SNZI node
+
+		template<size_type D>
+		using level = std::integral_constant<size_type, D>; //! Tag for the operations on the nodes at depth D
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+
+			constexpr node() : X(0){}
+		};
+
+	public:
+
+		constexpr static_snzi() : root(), others(){}
+
+		static_snzi(const static_snzi&) = delete;
+		static_snzi& operator=(const static_snzi&) = delete;
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid) or by any
+		 * thread with Depart(token), where token is the value returned by Arrive().
+		 *
+		 * \return The token that identifies the leaf at which the thread arrived.
+		 */
+		arrival_token Arrive(size_type tid){
+			const size_type leaf = get_leaf_for_thread(tid);
+			arrive_at(leaf, level<H>{});
+			return arrival_token(leaf);
+		}
+
+		/**
+		 * Called by a thread with identifier id, which should be in the range [0,T), after it has called Arrive() to declare
+		 * that is "departs".
+		 */
+		void Depart(size_type tid){
+			depart_at(get_leaf_for_thread(tid), level<H>{});
+		}
+
+		/**
+		 * Departs from the leaf at which the Arrive() operation that returned token arrived. It may be called by any thread, once per token.
+		 */
+		void Depart(arrival_token token){
+			depart_at(token.node(), level<H>{});
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in the SNZI tree.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool Query() const{
+			return root.X.load(snzi_order::query) != 0;
+		}
+
+	private:
+		node root; //! The root SNZI node of the tree
+		std::array<node, total_nodes - 1> others; //! The other SNZI nodes of the tree; the node with index i is at others[i-1]
+
+		/**
+		 * \return The index of the leaf where the thread with the given id calls its Arrive and Depart operations.
+		 */
+		static constexpr size_type get_leaf_for_thread(size_type tid){
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		}
+
+		/**
+		 * \return The index of the parent of the node with index id.
+		 */
+		static constexpr size_type parent(size_type id){
+			return (id - 1)/K;
+		}
+
+		void arrive_at(size_type, level<0>){
+			root.X.fetch_add(1, snzi_order::root_arrive);
+		}
+
+		void depart_at(size_type, level<0>){
+			root.X.fetch_sub(1, snzi_order::root_depart);
+		}
+
+		template<size_type D>
+		void arrive_at(size_type id, level<D>){
+			std::atomic<counter_type>& X = others[id - 1].X;
+			bool pArrInv = false;
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			do{
+				if (!oldx && !pArrInv){
+					arrive_at(parent(id), level<D - 1>{});
+					pArrInv = true;
+				}
+			} while (!X.compare_exchange_weak(oldx, oldx + 1, snzi_order::arrive, snzi_order::cas_failure));
+
+			if (pArrInv && oldx){
+				depart_at(parent(id), level<D - 1>{});
+			}
+		}
+
+		template<size_type D>
+		void depart_at(size_type id, level<D>){
+			std::atomic<counter_type>& X = others[id - 1].X;
+
+			counter_type oldx = X.load(snzi_order::probe);
+
+			while (!X.compare_exchange_weak(oldx, oldx - 1, snzi_order::depart, snzi_order::cas_failure)){}
+
+			if (oldx == 1){
+				depart_at(parent(id), level<D - 1>{});
+			}
+		}
+	};
+
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::arity;
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::height;
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::total_threads;
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::total_nodes;
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::total_leaf_nodes;
+	template<std::size_t K, std::size_t H, std::size_t T> constexpr std::size_t static_snzi<K,H,T>::threads_per_leaf;
+
+} // namespace concurrent
+
+#endif /* STATIC_SNZI_HPP_ */
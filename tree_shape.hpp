@@ -0,0 +1,149 @@
+#ifndef TREE_SHAPE_HPP_
+#define TREE_SHAPE_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace concurrent{
+
+	/**
+	 * Class tree_shape describes the shape of a SNZI tree whose levels may have different fan-outs.
+	 *
+	 * The shape is given as a fan-out vector listed from the root downwards: fanout[0] is the number of children of the root, fanout[1]
+	 * the number of children of each node at depth 1 and so on. The height of the tree is the size of the vector. For example, on a machine with
+	 * 2 sockets of 8 cores with 2 hardware threads each, the fan-out vector {2,8,2} gives a tree whose level 1 nodes map to the sockets, whose level 2
+	 * nodes map to the cores and whose leaves are shared by the hardware threads of a core. A perfect K-ary tree of height H is the special
+	 * case of a vector with H copies of K.
+	 *
+	 * The nodes are numbered in level order, starting with 0 for the root, which is the numbering used by the snzi classes. The nodes at depth d
+	 * occupy the indices [level_offset(d), level_offset(d+1)) and the children of the node at position p of level d are the nodes at positions
+	 * [p*fanout(d), (p+1)*fanout(d)) of level d+1. For a perfect K-ary tree this is the familiar parent(i) = (i-1)/K.
+	 */
+	class tree_shape{
+	public:
+		using size_type = std::size_t; //! For sizes and node indices
+
+		/**
+		 * Constructs the shape with the given fan-out vector (listed from the root downwards).
+		 *
+		 * \param fanout The number of children of the nodes at each level
+		 * \throws std::invalid_argument If any fan-out is lower than 2.
+		 */
+		explicit tree_shape(const std::vector<size_type>& fanout) : fanouts(fanout){
+			offsets.reserve(fanouts.size() + 2);
+
+			size_type level_size = 1;
+			offsets.push_back(0);
+			for (size_type f : fanouts){
+				if (f < 2){
+					throw std::invalid_argument("fan-out of every level in snzi constructor must be >= 2");
+				}
+				offsets.push_back(offsets.back() + level_size);
+				level_size *= f;
+			}
+			offsets.push_back(offsets.back() + level_size);
+		}
+
+		/**
+		 * Returns the shape of a perfect K-ary tree of height H.
+		 *
+		 * \throws std::invalid_argument If K is lower than 2.
+		 */
+		static tree_shape uniform(size_type K, size_type H){
+			if (K < 2){
+				throw std::invalid_argument("K parameter in snzi constructor must be >= 2");
+			}
+			return tree_shape(std::vector<size_type>(H, K));
+		}
+
+		/**
+		 * \return The height of the tree (the root alone has height 0).
+		 */
+		size_type height() const{
+			return fanouts.size();
+		}
+
+		/**
+		 * \return The total number of nodes in the tree.
+		 */
+		size_type nodes() const{
+			return offsets.back();
+		}
+
+		/**
+		 * \return The number of nodes in the last level of the tree.
+		 */
+		size_type leaves() const{
+			return level_size(height());
+		}
+
+		/**
+		 * \return The number of children of each node at depth d (0 for the last level).
+		 */
+		size_type fanout(size_type d) const{
+			return d < fanouts.size() ? fanouts[d] : 0;
+		}
+
+		/**
+		 * \return The index of the first node at depth d.
+		 */
+		size_type level_offset(size_type d) const{
+			return offsets[d];
+		}
+
+		/**
+		 * \return The number of nodes at depth d.
+		 */
+		size_type level_size(size_type d) const{
+			return offsets[d + 1] - offsets[d];
+		}
+
+		/**
+		 * \return The index of the node at position p of level d, where d must be at most height() and p lower than level_size(d).
+		 */
+		size_type node_at(size_type d, size_type p) const{
+			assert(d <= height() && p < level_size(d));
+			return offsets[d] + p;
+		}
+
+		/**
+		 * \return The depth of the node with index id.
+		 */
+		size_type depth(size_type id) const{
+			size_type d = 0;
+			while (id >= offsets[d + 1]){
+				++d;
+			}
+			return d;
+		}
+
+		/**
+		 * Returns the index of the parent of the node with index id, which must not be the root.
+		 *
+		 * \param id The index of the node
+		 * \return The index of id's parent
+		 */
+		size_type parent(size_type id) const{
+			size_type d = depth(id);
+			return offsets[d - 1] + (id - offsets[d])/fanouts[d - 1];
+		}
+
+		/**
+		 * Returns the index of the first child of the node with index id, which must not be in the last level. Its children are the
+		 * fanout(depth(id)) consecutive nodes starting at that index.
+		 */
+		size_type first_child(size_type id) const{
+			size_type d = depth(id);
+			return offsets[d + 1] + (id - offsets[d])*fanouts[d];
+		}
+
+	private:
+		std::vector<size_type> fanouts; //! The fan-out of each level, from the root downwards
+		std::vector<size_type> offsets; //! offsets[d] is the index of the first node at depth d; offsets[height()+1] is the number of nodes
+	};
+
+} // namespace concurrent
+
+#endif /* TREE_SHAPE_HPP_ */
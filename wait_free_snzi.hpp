@@ -0,0 +1,181 @@
+#ifndef WAIT_FREE_SNZI_HPP_
+#define WAIT_FREE_SNZI_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include "arrival_token.hpp"
+#include "config.hpp"
+#include "snzi_arena.hpp"
+#include "snzi_ordering.hpp"
+#include "tree_shape.hpp"
+
+namespace concurrent{
+
+	/**
+	 * Class wait_free_snzi implements a SNZI object whose Arrive and Depart operations complete in a bounded number of steps, whatever the
+	 * other threads do. The CAS loops of the other classes are lock-free: a thread whose CAS keeps failing under contention retries without
+	 * bound, which shows up in the far tail of the latency distribution.
+	 *
+	 * The word of a node holds the counter (in units of 2) and a settled bit that tells that the node holds an arrival at its parent.
+	 * Every step is a single atomic instruction that cannot fail, except for one CAS that is tried only once:
+	 * 			+ Arrive adds a unit with fetch_add. If the settled bit was set it returns: the bit is only cleared while the counter is 0,
+	 * 			  so the parent keeps the arrival while the thread is counted.
+	 * 			+ Otherwise the thread helps: whether it took the counter from 0 or another thread is still propagating, it arrives at the
+	 * 			  parent itself and sets the settled bit with fetch_or. If the bit was already set, another thread published its arrival
+	 * 			  at the parent first, and the thread departs from the parent again.
+	 * 			+ Depart subtracts a unit with fetch_sub. The thread that takes the counter to 0 tries once to clear the settled bit with a
+	 * 			  CAS from "0, settled" to "0"; if it succeeds it departs from the parent. If it fails, a new Arrive operation has already
+	 * 			  found the node settled and the arrival at the parent is handed over to it.
+	 * No thread waits for another, so a Depart operation takes at most 2H+1 atomic instructions and an Arrive operation O(H^2) in the
+	 * worst case (when it helps at every level and loses every race), where H is the height of the tree. The root is a plain counter.
+	 *
+	 * The helping costs extra arrivals at the parent when many threads find the same node 0 at once, which is what the announce flag of
+	 * semi_contention_handling_snzi avoids by waiting. The thread identifiers and the leaf assignment are those of snzi.hpp.
+	 */
+	class wait_free_snzi{
+	public:
+		using size_type = std::size_t; //! For sizes and thread identifiers
+
+	private:
+		using counter_type = std::uint64_t; //! Type of the word of each SNZI node
+
+		static const counter_type settled_bit = 1; //! Set while the node holds an arrival at its parent
+		static const counter_type unit = 2; //! The amount of an arrival
+
+		struct node{
+			// to avoid false sharing with other snzi nodes
+			alignas(CACHE_LINE_SIZE) std::atomic<counter_type> X;
+			size_type parent;
+
+			node(){
+				X.store(0, snzi_order::init);
+			}
+		};
+
+	public:
+
+		/**
+		 * Constructs a SNZI perfect K-ary tree with height H. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * \throws std::invalid_argument If K is lower than 2.
+		 */
+		wait_free_snzi(size_type K, size_type H, size_type T, snzi_arena* arena = nullptr) : wait_free_snzi(tree_shape::uniform(K,H), T, arena){}
+
+		/**
+		 * Constructs a SNZI tree with the given shape. T specifies the maximum number of threads that will use the SNZI object.
+		 *
+		 * The nodes are allocated from arena (see snzi_arena.hpp), which must outlive the SNZI object, or from the heap if arena is nullptr.
+		 */
+		wait_free_snzi(const tree_shape& shape, size_type T, snzi_arena* arena = nullptr) : shape(shape){
+			total_nodes = shape.nodes();
+			total_leaf_nodes = shape.leaves();
+			threads_per_leaf = static_cast<size_type>(std::ceil((double)T/(double)total_leaf_nodes));
+			if (!threads_per_leaf){
+				threads_per_leaf = 1;
+			}
+			total_threads = T;
+
+			nodes = make_node_array<node>(arena, total_nodes);
+			for (size_type i = 1; i < total_nodes; ++i){
+				nodes[i].parent = shape.parent(i);
+			}
+		}
+
+		/**
+		 * Called by a thread with identifier tid, which should be in the range [0,T), to declare its presence.
+		 *
+		 * An Arrive() operation by a thread should be matched by a Depart() operation, either by the same thread with Depart(tid) or by any
+		 * thread with Depart(token), where token is the value returned by Arrive().
+		 *
+		 * \return The token that identifies the node at which the thread arrived.
+		 */
+		arrival_token Arrive(size_type tid){
+			const size_type leaf = get_leaf_for_thread(tid);
+			arrive_at(leaf);
+			return arrival_token(leaf);
+		}
+
+		/**
+		 * Called by a thread with identifier id, which should be in the range [0,T), after it has called Arrive() to declare
+		 * that is "departs".
+		 */
+		void Depart(size_type tid){
+			depart_at(get_leaf_for_thread(tid));
+		}
+
+		/**
+		 * Departs from the node at which the Arrive() operation that returned token arrived. It may be called by any thread, once per token.
+		 */
+		void Depart(arrival_token token){
+			depart_at(token.node());
+		}
+
+		/**
+		 * Tests whether there is an "active" thread that has arrived in the SNZI tree.
+		 *
+		 * \return True is there is a surplus of Arrive operations from Depart operations.
+		 */
+		bool Query() const{
+			return nodes[0].X.load(snzi_order::query) != 0;
+		}
+
+	private:
+		tree_shape shape; //! The shape of the SNZI tree
+		size_type total_nodes; //! Total number on nodes in the SNZI tree
+		size_type total_leaf_nodes; //! Number of leaf nodes in the SNZI tree
+		size_type threads_per_leaf; //! The range of threads allocated to each leaf node
+		size_type total_threads; //! Number of threads to use this SNZI object
+		node_array<node> nodes{nullptr}; //! The SNZI nodes of the tree in level order; nodes[0] is the root
+
+		void arrive_at(size_type id){
+			if (!id){
+				nodes[0].X.fetch_add(1, snzi_order::root_arrive);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes[id].X;
+
+			if (X.fetch_add(unit, snzi_order::arrive) & settled_bit){
+				return ;
+			}
+
+			arrive_at(nodes[id].parent);
+
+			if (X.fetch_or(settled_bit, snzi_order::arrive) & settled_bit){
+				// another thread published its arrival at the parent first
+				depart_at(nodes[id].parent);
+			}
+		}
+
+		void depart_at(size_type id){
+			if (!id){
+				nodes[0].X.fetch_sub(1, snzi_order::root_depart);
+				return ;
+			}
+
+			std::atomic<counter_type>& X = nodes[id].X;
+
+			if (X.fetch_sub(unit, snzi_order::depart)/unit != 1){
+				return ;
+			}
+
+			counter_type expected = settled_bit;
+			if (X.compare_exchange_strong(expected, 0, snzi_order::depart, snzi_order::cas_failure)){
+				depart_at(nodes[id].parent);
+			}
+		}
+
+		/**
+		 * Returns the index of the leaf node where the thread with the given id is assigned (as in snzi.hpp).
+		 */
+		size_type get_leaf_for_thread(size_type tid) const{
+			return total_nodes - total_leaf_nodes + ((tid/threads_per_leaf)%total_leaf_nodes);
+		}
+	};
+
+} // namespace concurrent
+
+#endif /* WAIT_FREE_SNZI_HPP_ */